@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include "board.hpp"
+
+namespace Attacks {
+    uint64_t pawn(int side, int square);
+    uint64_t pawnsSetwise(int side, uint64_t pawns);
+    uint64_t knight(int square);
+    uint64_t bishop(int square, uint64_t occupied);
+    uint64_t rook(int square, uint64_t occupied);
+    uint64_t queen(int square, uint64_t occupied);
+    uint64_t king(int square);
+}
+
+// Attack maps for one position, computed once per node and shared by
+// evaluation, SEE, check detection and move generation.
+struct AttackInfo {
+    std::array<std::array<uint64_t, 6>, 2> byPiece{};
+    std::array<uint64_t, 2> bySide{};
+    std::array<uint64_t, 2> doubleAttacks{};
+
+    // Squares around each side's king and how that zone is attacked by
+    // the opposite side: attacker count, summed attacker weight and the
+    // number of attacked zone squares.
+    std::array<uint64_t, 2> kingZone{};
+    std::array<int, 2> kingSquare{};
+    std::array<int, 2> kingAttackersCount{};
+    std::array<int, 2> kingAttackersWeight{};
+    std::array<int, 2> kingZoneAttacks{};
+
+    // Safe squares reachable per piece type, summed over all pieces.
+    std::array<std::array<int, 6>, 2> mobility{};
+
+    uint64_t checkers{0};
+
+    void compute(const Board& board);
+    void compute(const std::array<uint64_t, 12>& pieces, uint64_t occupied, int sideToMove);
+
+    bool isInCheck(int side) const { return (bySide[!side] >> kingSquare[side]) & 1; }
+    bool isAttacked(int square, int bySideToCheck) const { return (bySide[bySideToCheck] >> square) & 1; }
+
+    // Static exchange evaluation of a capture, using the cached maps to skip
+    // the swap loop when the target square is not defended.
+    int see(const Board& board, uint16_t move) const;
+
+    static uint64_t attackersTo(const Board& board, int square, uint64_t occupied);
+    static uint64_t attackersTo(const std::array<uint64_t, 12>& pieces, int square, uint64_t occupied);
+    // Squares strictly between two squares on a line, or 0 if not aligned.
+    static uint64_t between(int from, int to);
+
+    static constexpr std::array<int, 6> KING_ATTACK_WEIGHT = {0, 2, 2, 3, 5, 0};
+    static constexpr std::array<int, 6> SEE_VALUE = {100, 320, 330, 500, 900, 20000};
+};
@@ -5,10 +5,12 @@
 #include <vector>
 #include <string>
 #include <memory>
-#include <intrin.h>
 #include "../utils/move_generator.hpp"
+#include "../eval/psqt.hpp"
 
 #ifdef _MSC_VER
+#include <intrin.h>
+
 inline int __builtin_ctzll(unsigned long long x) {
     unsigned long index;
     _BitScanForward64(&index, x);
@@ -27,6 +29,26 @@ static constexpr uint64_t FILE_H = 0x8080808080808080ULL;
 
 static constexpr int MATE_BOUND = 30000;
 
+class AccumulatorStack;
+
+// Piece placements changed by one move, recorded for incremental network
+// updates. A legal move removes at most two pieces (mover and captured, or
+// king and rook) and adds at most two; anything else sets overflow.
+struct DirtyPiece {
+    static constexpr int MAX_CHANGES = 2;
+    
+    struct Change {
+        int piece;
+        int square;
+    };
+    
+    std::array<Change, MAX_CHANGES> removed{};
+    std::array<Change, MAX_CHANGES> added{};
+    int removedCount{0};
+    int addedCount{0};
+    bool overflow{false};
+};
+
 class Board {
 public:
     static constexpr int WHITE = 0;
@@ -59,14 +81,33 @@ public:
     int getSideToMove() const;
     uint64_t getOccupied() const;
     int getEnPassantSquare() const;
+    int getCastlingRights() const { return castlingRights; }
+    const std::array<uint64_t, 12>& getPieces() const { return pieces; }
     uint64_t getHash() const { return hash; }
+    PSQT::Score getPsqScore() const { return psqScore; }
+    int getPhase() const { return phase; }
     std::vector<uint16_t> generateLegalMoves() const;
     int getPieceAt(int square) const;
     
+    // Legal moves push their DirtyPiece onto the attached stack and
+    // unmakeMove pops it. Copies of the board start detached.
+    void attachAccumulators(AccumulatorStack* stack);
+    
 private:
+    struct AccumulatorHook {
+        AccumulatorStack* stack{nullptr};
+        
+        AccumulatorHook() = default;
+        AccumulatorHook(const AccumulatorHook&) {}
+        AccumulatorHook& operator=(const AccumulatorHook&) { return *this; }
+    };
+    
+
     std::array<uint64_t, 12> pieces{};
     uint64_t occupied{0};
     uint64_t hash{0};
+    PSQT::Score psqScore{0};
+    int phase{0};
     int sideToMove{0};
     int castlingRights{0};
     int enPassantSquare{-1};
@@ -77,12 +118,18 @@ private:
         uint16_t move;
         int castlingRights;
         int enPassantSquare;
+        int halfMoveClock;
+        int capturedPiece;
         uint64_t hash;
     };
     
     std::vector<UndoInfo> history{};
+    DirtyPiece dirtyPiece{};
+    bool trackingDirty{false};
+    AccumulatorHook accumulators{};
     
     void clearBoard();
+    void undoMove(uint16_t move);
     void updateOccupied();
     void placePiece(int piece, int square);
     void removePiece(int piece, int square);
@@ -92,4 +139,5 @@ private:
     friend class MoveGenerator;
     friend class Evaluator;
     friend class EndgameTablebases;
+    friend struct AttackInfo;
 };
@@ -8,8 +8,13 @@
 #include <thread>
 #include <iostream>
 #include <stdexcept>
+#include <ostream>
+#include "../board/board.hpp"
 #include "../utils/move_generator.hpp"
 #include "../neural/neural_network.hpp"
+#include "../neural/quantized_network.hpp"
+#include "../neural/accumulator_stack.hpp"
+#include "../neural/ensemble_network.hpp"
 #include "../mcts/mcts.hpp"
 #include "../eval/evaluator.hpp"
 
@@ -26,12 +31,31 @@ public:
     void setMultiPV(int mpv);
     void setThreadCount(int threads);
     void loadNetwork(const std::string& path);
+    void loadEnsemble(const std::string& path);
+    void setOption(const std::string& command);
+    void setEvalCacheSize(size_t sizeKB);
+    void printEvalTrace(std::ostream& out);
+    void bench(std::ostream& out);
     
 private:
     static constexpr int MAX_DEPTH = 100;
     static constexpr int MAX_PLY = 246;
     static constexpr int TT_SIZE = 1024 * 1024 * 128;
     static constexpr int INFINITE = 30000;
+    static constexpr int BENCH_ITERATIONS = 200;
+    // Used when "go" gives no clock, movetime or node limit.
+    static constexpr int DEFAULT_MOVE_TIME_MS = 1000;
+    static constexpr int DEFAULT_MOVES_TO_GO = 30;
+    static constexpr int MOVE_OVERHEAD_MS = 30;
+    static constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    static constexpr const char* DEFAULT_EVAL_FILE = "network.nnue";
+    static constexpr const char* FLOAT_WEIGHTS_FILE = "weights.bin";
+    
+    // Ensemble spread (standard deviation of member outputs) beyond which a
+    // node is extended, and below which a non-PV node is reduced.
+    static constexpr int UNCERTAINTY_MIN_DEPTH = 3;
+    static constexpr float UNCERTAIN_SPREAD = 0.15f;
+    static constexpr float CONFIDENT_SPREAD = 0.02f;
     
     struct SearchInfo {
         int depth{0};
@@ -40,6 +64,15 @@ private:
         int score{0};
     };
     
+    // Limits from the last "go" command; 0 where none was given.
+    struct TimeControl {
+        std::array<int, 2> time{};          // ms left, indexed by side
+        std::array<int, 2> increment{};
+        int movesToGo{0};
+        int moveTime{0};
+        uint64_t nodes{0};
+    };
+    
     struct Position {
         std::array<Bitboard, 12> pieces{};
         Bitboard occupied{0};
@@ -60,26 +93,49 @@ private:
     };
     
     Position pos;
+    std::vector<Position> positionHistory;  // restored by unmakeMove
+    TimeControl timeControl;
+    Board board;
+    size_t evalCacheSizeKB{EvalCache<int>::DEFAULT_SIZE_KB};
+    std::string gameFen;                // last "position" command, to match the MCTS tree to
+    std::vector<uint16_t> gameMoves;
+    std::string evalFile;               // empty: embedded network, else DEFAULT_EVAL_FILE
+    bool verifyEvalFile{true};
+    bool floatNetworkLoaded{false};
     std::shared_ptr<NeuralNetwork> network;
+    std::shared_ptr<QuantizedNetwork> quantizedNetwork;
+    std::shared_ptr<EnsembleNetwork> ensemble;
+    bool ensembleLoaded{false};
+    AccumulatorStack accumulators;
     std::shared_ptr<Evaluator> evaluator;
     std::unique_ptr<MoveGenerator> moveGen;
+    bool mctsBatch{false};              // as set; honoured only with the float network loaded
+    std::shared_ptr<EvalBatcher> evalBatcher;      // null unless mctsBatch is honoured
     std::shared_ptr<MCTS> mcts;
     std::vector<uint64_t> transpositionTable;
     std::vector<std::thread> threadPool;
-    bool useNNUE{true};
+    bool useNNUE{true};                 // alpha-beta; cleared by UseMCTS
+    int rootPly{0};
+    int rootDepth{0};
     
     void initializeTranspositionTable();
     void loadNetworkWeights();
+    void updateBatcher();
     void setupThreadPool();
     std::string getBestMoveNNUE(const std::vector<MoveGenerator::Move>& moves);
     std::string getBestMoveMCTS(const std::vector<MoveGenerator::Move>& moves);
     void parseTimeControl(const std::string& command);
-    void makeMove(const MoveGenerator::Move& move);
+    int allocateTimeMs() const;
+    // Plays the move on both pos and board; false, with neither changed, if
+    // it leaves the mover in check.
+    bool makeMove(const MoveGenerator::Move& move);
     void unmakeMove(const MoveGenerator::Move& move);
     int alphaBeta(int alpha, int beta, int depth, bool isPV);
     int quiescence(int alpha, int beta);
+    int uncertaintyAdjustment(int depth, bool isPV) const;
     void updateSearch(const SearchInfo& info);
     std::string moveToString(const MoveGenerator::Move& move) const;
+    static uint16_t packMove(const MoveGenerator::Move& move);
     std::string extractFEN(const std::string& command) const;
     std::string extractMoves(const std::string& command) const;
     void setStartPosition();
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+
+// Small direct-mapped cache of static evaluations keyed by Zobrist hash.
+// Each search thread owns its own instance, so no synchronisation is needed.
+// A zero key or a zero size disables the cache.
+template<typename T>
+class EvalCache {
+public:
+    static constexpr size_t DEFAULT_SIZE_KB = 256;
+
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t probes{0};
+
+        double hitRate() const {
+            return probes ? static_cast<double>(hits) / static_cast<double>(probes) : 0.0;
+        }
+    };
+
+    explicit EvalCache(size_t sizeKB = DEFAULT_SIZE_KB) {
+        resize(sizeKB);
+    }
+
+    void resize(size_t sizeKB) {
+        size_t count = sizeKB * 1024 / sizeof(Entry);
+        size_t entriesPow2 = count ? 1 : 0;
+        while (entriesPow2 && entriesPow2 * 2 <= count) entriesPow2 *= 2;
+
+        entries.assign(entriesPow2, Entry{});
+        mask = entriesPow2 ? entriesPow2 - 1 : 0;
+        configuredKB = sizeKB;
+        stats = Stats{};
+    }
+
+    void clear() {
+        std::fill(entries.begin(), entries.end(), Entry{});
+        stats = Stats{};
+    }
+
+    bool probe(uint64_t key, T& value) {
+        if (!key || entries.empty()) return false;
+
+        ++stats.probes;
+        const Entry& entry = entries[key & mask];
+        if (entry.key != key) return false;
+
+        ++stats.hits;
+        value = entry.value;
+        return true;
+    }
+
+    void store(uint64_t key, T value) {
+        if (!key || entries.empty()) return;
+        entries[key & mask] = Entry{key, value};
+    }
+
+    size_t sizeKB() const { return configuredKB; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Entry {
+        uint64_t key{0};
+        T value{};
+    };
+
+    std::vector<Entry> entries;
+    uint64_t mask{0};
+    size_t configuredKB{0};
+    Stats stats;
+};
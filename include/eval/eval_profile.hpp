@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Compile-time gated cycle counters for the evaluation terms. Build with
+// EVAL_PROFILE defined (CMake option CHESS_EVAL_PROFILE) to enable them;
+// otherwise EVAL_PROFILE_SCOPE expands to nothing.
+namespace EvalProfile {
+    enum Term {
+        ATTACKS,
+        PSQ,
+        PAWN_STRUCTURE,
+        MOBILITY,
+        KING_SAFETY,
+        THREATS,
+        TERM_COUNT
+    };
+
+    inline constexpr std::array<const char*, TERM_COUNT> TERM_NAMES = {
+        "Attack maps", "Material+PST", "Pawn structure", "Mobility", "King safety", "Threats"
+    };
+
+    struct Counter {
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> calls{0};
+    };
+
+    std::array<Counter, TERM_COUNT>& counters();
+    uint64_t readCycles();
+    void reset();
+    void report(std::ostream& out);
+
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Term term) : term(term), start(readCycles()) {}
+        ~ScopedTimer() {
+            auto& counter = counters()[term];
+            counter.cycles.fetch_add(readCycles() - start, std::memory_order_relaxed);
+            counter.calls.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        Term term;
+        uint64_t start;
+    };
+}
+
+#ifdef EVAL_PROFILE
+#define EVAL_PROFILE_SCOPE(term) EvalProfile::ScopedTimer evalProfileTimer(EvalProfile::term)
+#else
+#define EVAL_PROFILE_SCOPE(term) ((void)0)
+#endif
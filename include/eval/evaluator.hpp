@@ -2,25 +2,103 @@
 
 #include <cstdint>
 #include <array>
+#include <algorithm>
+#include <atomic>
 #include "../board/board.hpp"
+#include "../board/attack_info.hpp"
+#include "psqt.hpp"
+#include "eval_cache.hpp"
+#include "eval_profile.hpp"
+#include "../neural/neural_network.hpp"
 
 class Evaluator {
 public:
+    // Per-term breakdown from White's point of view, in centipawns.
+    struct Trace {
+        int material{0};
+        int pst{0};
+        int pawnStructure{0};
+        int mobility{0};
+        int kingSafety{0};
+        int threats{0};
+        int total{0};
+        int phase{0};
+    };
+    
     Evaluator() = default;
+    // Shares the network weights with every other evaluator and search
+    // thread; each thread evaluating adds only its own AccumulatorState.
+    explicit Evaluator(std::shared_ptr<const NetworkWeights> weights);
     ~Evaluator() = default;
     
-    int evaluate(const std::array<uint64_t, 12>& pieces, uint64_t occupied, int sideToMove);
+    int evaluate(const Board& board);
+    int evaluate(const Board& board, const AttackInfo& attacks);
+    
+    // Lazy evaluation: cheap terms first, returning as soon as the terms
+    // still to come cannot bring the score back inside (alpha, beta).
+    int evaluate(const Board& board, int alpha, int beta);
+    
+    Trace trace(const Board& board);
+    
+    // Network output in [-1, 1] for the side to move, or 0 without weights.
+    // Goes through the network's eval cache under key (the position's hash).
+    float evaluateNetwork(uint64_t key, const std::array<uint64_t, 12>& pieces, int sideToMove) const;
+    // Plus policy logits for moves; see NeuralNetwork::forward. Not cached.
+    float evaluateNetwork(const std::array<uint64_t, 12>& pieces, int sideToMove,
+                          const std::vector<uint16_t>& moves, std::vector<float>& logits) const;
+    bool hasNetworkPolicy() const { return networkWeights && networkWeights->hasPolicy(); }
+    // Not safe while other threads are in evaluateNetwork.
+    void setNetworkWeights(std::shared_ptr<const NetworkWeights> weights);
+    
+    // Per-thread eval cache, sized independently of the transposition table.
+    static void setCacheSize(size_t sizeKB);
+    static EvalCache<int>::Stats getCacheStats();
     
 private:
-    static constexpr int PAWN_VALUE = 100;
-    static constexpr int KNIGHT_VALUE = 320;
-    static constexpr int BISHOP_VALUE = 330;
-    static constexpr int ROOK_VALUE = 500;
-    static constexpr int QUEEN_VALUE = 900;
-    
-    int evaluateMaterial(const std::array<uint64_t, 12>& pieces);
-    int evaluatePosition(const std::array<uint64_t, 12>& pieces);
-    int evaluatePawnStructure(const std::array<uint64_t, 12>& pieces);
-    int evaluateMobility(const std::array<uint64_t, 12>& pieces, uint64_t occupied);
-    int evaluateKingSafety(const std::array<uint64_t, 12>& pieces, uint64_t occupied);
+    std::shared_ptr<const NetworkWeights> networkWeights;
+    
+    static inline std::atomic<size_t> cacheSizeKB{EvalCache<int>::DEFAULT_SIZE_KB};
+    static EvalCache<int>& threadCache();
+    
+    static constexpr int ISOLATED_PAWN = 20;
+    static constexpr int DOUBLED_PAWN = 10;
+    static constexpr int PASSED_PAWN = 30;
+    static constexpr int OPEN_FILE = 10;
+    static constexpr int SEMI_OPEN_FILE = 5;
+    static constexpr int KING_SHIELD = 10;
+    
+    static constexpr std::array<int, 6> MOBILITY_WEIGHT = {0, 4, 5, 2, 1, 0};
+    static constexpr std::array<int, 6> MAX_MOBILITY_SQUARES = {0, 8, 13, 14, 27, 0};
+    static constexpr std::array<int, 6> MAX_MOBILE_PIECES = {0, 2, 2, 2, 1, 0};
+    static constexpr int MAX_KING_DANGER = 400;
+    static constexpr int THREAT_BY_PAWN = 40;
+    static constexpr int HANGING_PIECE = 25;
+    static constexpr int MAX_THREAT_PENALTY = 2 * THREAT_BY_PAWN + 2 * HANGING_PIECE;
+    
+    // Largest swing each term can add to the score, derived from the weights above.
+    static constexpr int MAX_PAWN_STRUCTURE_SCORE =
+        2 * 8 * std::max(PASSED_PAWN, ISOLATED_PAWN + DOUBLED_PAWN) + 3 * std::max(OPEN_FILE, SEMI_OPEN_FILE);
+    static constexpr int MAX_MOBILITY_SCORE =
+        MOBILITY_WEIGHT[Board::KNIGHT] * MAX_MOBILITY_SQUARES[Board::KNIGHT] * MAX_MOBILE_PIECES[Board::KNIGHT] +
+        MOBILITY_WEIGHT[Board::BISHOP] * MAX_MOBILITY_SQUARES[Board::BISHOP] * MAX_MOBILE_PIECES[Board::BISHOP] +
+        MOBILITY_WEIGHT[Board::ROOK] * MAX_MOBILITY_SQUARES[Board::ROOK] * MAX_MOBILE_PIECES[Board::ROOK] +
+        MOBILITY_WEIGHT[Board::QUEEN] * MAX_MOBILITY_SQUARES[Board::QUEEN] * MAX_MOBILE_PIECES[Board::QUEEN];
+    
+    static constexpr int LAZY_MARGIN_ATTACKS =
+        MAX_MOBILITY_SCORE + 3 * KING_SHIELD + MAX_KING_DANGER + MAX_THREAT_PENALTY;
+    static constexpr int LAZY_MARGIN_PAWNS = LAZY_MARGIN_ATTACKS + MAX_PAWN_STRUCTURE_SCORE;
+    
+    int getPsqScore(const Board& board);
+    int getMobilityScore(const AttackInfo& attacks);
+    int getPawnStructureScore(const Board& board);
+    int getKingSafetyScore(const Board& board, const AttackInfo& attacks);
+    int getThreatScore(const Board& board, const AttackInfo& attacks);
+    
+    static int getOpenFileCount(const Board& board, int side);
+    static int getSemiOpenFileCount(const Board& board, int side);
+    static bool isIsolatedPawn(const Board& board, int square);
+    static bool isDoubledPawn(const Board& board, int square);
+    static bool isPassedPawn(const Board& board, int square);
+    static int getKingShieldScore(const Board& board, int side);
+    static int getKingDanger(const AttackInfo& attacks, int side);
 };
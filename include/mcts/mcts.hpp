@@ -1,49 +1,293 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <array>
 #include <memory>
 #include <vector>
 #include <random>
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include "../utils/move_generator.hpp"
+#include "../board/board.hpp"
 #include "../eval/evaluator.hpp"
+#include "../neural/eval_batcher.hpp"
+#include "../neural/accumulator_stack.hpp"
+#include "../endgame/tablebases.hpp"
+#include "node_arena.hpp"
 
+// Tree-parallel MCTS. Every thread walks the shared tree without locks:
+// statistics are atomics, a virtual loss on the selection path steers other
+// threads away from it, and a node is expanded by whichever thread wins a
+// CAS on its expansion state. A thread that reaches a node another thread is
+// still expanding abandons that playout rather than waiting.
+//
+// With transpositions enabled the tree becomes a DAG: nodes are keyed by
+// Zobrist hash in a lock-free table, and edges from different parents point
+// to the same node, so a position reached by several move orders is
+// expanded and evaluated once. Exploration then counts visits per edge,
+// while value is averaged over every visit to the shared node.
+//
+// Tree memory is budgeted. Once expansions would exceed the limit, the
+// threads pause, the least visited half of the expanded nodes collapse back
+// into leaves (keeping their statistics), and the freed nodes and edges are
+// recycled into the arenas. If that frees too little, the search carries on
+// without expanding.
+//
+// Game results are proven as in MCTS-Solver: checkmates, stalemates and
+// tablebase hits mark their node, and a parent is proven by minimax over its
+// children as soon as that is decided. Playouts stop at proven nodes, and
+// moves proven lost are only chosen when nothing else is left.
+//
+// Edge priors are the softmax of the network's policy logits when the loaded
+// weights have a policy head, and of a cheap heuristic (captures, checks,
+// promotions and a history of moves that did well) otherwise.
+//
+// For very small budgets the root move can instead be chosen as in Gumbel
+// MuZero: Gumbel top-k sampling from the priors, then sequential halving
+// over a fixed number of simulations.
 class MCTS {
 public:
-    struct Node {
-        MoveGenerator::Move move{};
-        float value{0.0f};
-        float prior{0.0f};
-        int visits{0};
-        std::vector<std::unique_ptr<Node>> children;
-        Node* parent{nullptr};
+    static constexpr float PRIOR_SCALE = 65535.0f;
+    static constexpr size_t DEFAULT_TABLE_ENTRIES = 1 << 20;
+    static constexpr size_t DEFAULT_MEMORY_LIMIT = size_t{1024} << 20;
+    
+    enum ExpansionState : uint8_t {
+        UNEXPANDED,
+        EXPANDING,
+        EXPANDED,
+        TERMINAL
+    };
+    
+    // Where priors come from. AUTO is the network's policy head if it has
+    // one and the heuristic if not; UNIFORM is equal priors with some noise.
+    enum PolicyMode : uint8_t {
+        POLICY_AUTO,
+        POLICY_HEURISTIC,
+        POLICY_UNIFORM
+    };
+    
+    // From the side that moved into the node, like its value.
+    enum Proof : uint8_t {
+        UNPROVEN,
+        WON,
+        LOST,
+        DRAWN
+    };
+    
+    struct Node;
+    
+    // One legal move out of a node; the child is created on first visit.
+    struct Edge {
+        uint16_t move{0};                   // Board encoding: from | to << 6 | promotion << 12
+        uint16_t prior{0};                  // fixed point, PRIOR_SCALE is 1.0
+        std::atomic<int> visits{0};         // through this edge; a shared child may have more
+        std::atomic<Node*> child{nullptr};
         
-        Node() = default;
-        ~Node() = default;
+        float getPrior() const { return prior * (1.0f / PRIOR_SCALE); }
     };
-
-    explicit MCTS(std::shared_ptr<Evaluator> eval);
+    
+    struct Node {
+        std::atomic<float> value{0.0f};     // sum of backed-up values, from the parent's side
+        std::atomic<int> visits{0};
+        std::atomic<int> virtualLoss{0};
+        std::atomic<ExpansionState> state{UNEXPANDED};
+        uint8_t edgeCount{0};
+        std::atomic<Proof> proof{UNPROVEN}; // always set on TERMINAL nodes
+        // Written only by the expanding thread, before state becomes EXPANDED.
+        Edge* edges{nullptr};
+    };
+    
+    struct Stats {
+        uint64_t playouts{0};
+        uint64_t collisions{0};     // playouts abandoned at a node being expanded
+        size_t treeBytes{0};        // live nodes and edges
+        size_t reservedBytes{0};    // held by the arenas, live or free
+        uint64_t prunedNodes{0};
+        int reusedVisits{0};        // root visits carried over from earlier searches
+        uint64_t transpositions{0}; // edges linked to a node another path created
+        Proof rootProof{UNPROVEN};  // from the side to move's opponent, like any node
+        int64_t timeMs{0};
+    };
+    
+    // 0 means no limit of that kind. The search also ends once the best move
+    // can no longer change: when the runner-up could not catch the leader's
+    // root visits with every playout the rest of the budget is expected to
+    // allow.
+    struct Limits {
+        int timeMs{0};
+        uint64_t playouts{0};
+    };
+    
+    // With a batcher, leaves are evaluated by the float network in batches.
+    // Each thread claims up to maxBatch / threads leaves under virtual loss
+    // before submitting them together, so a batch is not capped at the
+    // number of threads. Otherwise a quantized network set with setNetwork is used, updated
+    // incrementally along each playout, and failing that the evaluator's
+    // network weights, one at a time.
+    explicit MCTS(std::shared_ptr<Evaluator> eval, std::shared_ptr<EvalBatcher> batcher = nullptr);
     ~MCTS() = default;
     
-    MoveGenerator::Move getBestMove(const std::array<uint64_t, 12>& pieces,
-                                  uint64_t occupied,
-                                  int side,
-                                  int castling,
-                                  int enPassant,
-                                  int timeMs) const;
+    MoveGenerator::Move getBestMove(const Board& board, const Limits& limits);
+    
+    // Of the last getBestMove call.
+    Stats getStats() const { return stats; }
+    
+    // Makes the subtree reached by move (Board encoding) the root for the
+    // next search, keeping its statistics; if the search never visited that
+    // move the tree is dropped. Call once per move played, ours and theirs.
+    void advance(uint16_t move);
+    void clearTree();
+    
+    // Search threads, one by default per hardware thread. A new count drops
+    // the tree. Not while a search is running.
+    void setThreads(int count);
+    
+    // Searches a DAG instead of a tree from the next search on. entries is
+    // rounded down to a power of two; a full table falls back to unshared nodes.
+    void setTranspositions(bool enabled, size_t entries = DEFAULT_TABLE_ENTRIES);
+    
+    // Call whenever the network weights change, like AccumulatorStack::setNetwork.
+    void setNetwork(const QuantizedNetwork* network);
+    
+    // Budget in bytes for nodes and edges; 0 for none. Takes effect from the
+    // next expansion.
+    void setMemoryLimit(size_t bytes) { memoryLimit = bytes; }
+    
+    void setPolicyMode(PolicyMode mode) { policyMode = mode; }
+    
+    // With Gumbel root sampling on, every search runs exactly that many
+    // simulations (clamped to 16-200), whatever its limits say; a forced
+    // move or a proven root ends it sooner.
+    void setGumbel(bool enabled) { gumbel = enabled; }
+    void setGumbelSimulations(int simulations) {
+        gumbelSimulations = std::clamp(simulations, MIN_GUMBEL_SIMULATIONS, MAX_GUMBEL_SIMULATIONS);
+    }
+    
+    // Null evaluates leaves one at a time, as without a batcher. Not while a
+    // search is running.
+    void setBatcher(std::shared_ptr<EvalBatcher> newBatcher) { batcher = std::move(newBatcher); }
+    
+    // Probed at every leaf with few enough pieces; null turns probing off.
+    // Not while a search is running.
+    void setTablebases(std::shared_ptr<EndgameTablebases> tb);
                                   
 private:
     static constexpr float C_PUCT = 1.41f;
     static constexpr int VIRTUAL_LOSS = 3;
+    static constexpr int MAX_DEPTH = 1000;
+    static constexpr int MAX_PROBES = 32;
+    static constexpr uint64_t STOP_CHECK_INTERVAL = 64;     // playouts
+    // Heuristic policy logits.
+    static constexpr float CAPTURE_LOGIT = 1.0f;
+    static constexpr float CAPTURE_GAIN_LOGIT = 0.002f;     // per centipawn of victim less attacker / 10
+    static constexpr float CHECK_LOGIT = 1.0f;
+    static constexpr float PROMOTION_LOGIT = 1.5f;
+    static constexpr float HISTORY_LOGIT = 0.25f;           // per log of history count
+    static constexpr int MIN_GUMBEL_SIMULATIONS = 16;
+    static constexpr int MAX_GUMBEL_SIMULATIONS = 200;
+    static constexpr int DEFAULT_GUMBEL_SIMULATIONS = 64;
+    static constexpr int GUMBEL_TOP_K = 16;
+    static constexpr float GUMBEL_C_VISIT = 50.0f;
+    static constexpr float GUMBEL_C_SCALE = 1.0f;
+    // Charged per legal move at expansion: the edge and the child it may get.
+    static constexpr size_t BYTES_PER_MOVE = sizeof(Edge) + sizeof(Node);
+    
+    struct TableSlot {
+        std::atomic<uint64_t> key{0};       // 0 marks an empty slot
+        std::atomic<Node*> node{nullptr};   // published right after key
+    };
+    
+    // One thread's walk from the root. edges[i] leads from nodes[i] to nodes[i + 1].
+    struct Path {
+        std::vector<Node*> nodes;
+        std::vector<Edge*> edges;
+    };
+    
+    // A leaf claimed for expansion, with what is needed to finish it once
+    // its evaluation is in.
+    struct Leaf {
+        Path path;                          // ends at the leaf, virtual loss still on
+        std::array<uint64_t, 12> pieces;
+        int sideToMove{0};
+        uint64_t key{0};
+        std::vector<uint16_t> moves;
+        std::vector<float> logits;          // filled by the policy head if networkPolicy
+        bool networkPolicy{false};
+        float value{0.0f};                  // the network's, for the side to move
+    };
     
     std::shared_ptr<Evaluator> evaluator;
-    std::unique_ptr<Node> root;
-    
-    void search(Node* node, const std::array<uint64_t, 12>& pieces,
-               uint64_t occupied, int side, int depth, std::mt19937& rng) const;
-    Node* select(Node* node, std::mt19937& rng) const;
-    float expand(Node* node, const std::array<uint64_t, 12>& pieces,
-                uint64_t occupied, int side, std::mt19937& rng) const;
-    void backup(Node* node, float value) const;
-    float getUCT(const Node* node, float parentVisits) const;
+    std::shared_ptr<EvalBatcher> batcher;
+    // One per search thread. After advance() the rest of the old tree is
+    // still in them; the next search copies the kept subtree into spare and
+    // drops the others wholesale.
+    std::vector<std::unique_ptr<NodeArena>> arenas;
+    std::unique_ptr<NodeArena> spare;
+    // Per search thread, attached to that thread's board for the search.
+    std::vector<std::unique_ptr<AccumulatorStack>> accumulators;
+    int threadCount;                        // search threads, as set with setThreads
+    const QuantizedNetwork* network{nullptr};
+    Node* root{nullptr};
+    bool rootAdvanced{false};
+    Stats stats;
+    std::atomic<uint64_t> transpositions{0};
+    
+    std::unique_ptr<TableSlot[]> table;     // null unless transpositions are on
+    size_t tableMask{0};
+    
+    size_t memoryLimit{DEFAULT_MEMORY_LIMIT};
+    std::atomic<size_t> committedBytes{0};  // charged against memoryLimit
+    std::atomic<bool> memoryFull{false};
+    
+    PolicyMode policyMode{POLICY_AUTO};
+    bool gumbel{false};
+    int gumbelSimulations{DEFAULT_GUMBEL_SIMULATIONS};
+    // Backups that favoured each move (index from | to << 6), halved every search.
+    std::array<std::atomic<uint32_t>, 64 * 64> history{};
+    
+    std::shared_ptr<EndgameTablebases> tablebases;
+    std::mutex tablebaseMutex;              // probes update the tablebase cache
+    
+    void prepareTree(const Board& board);
+    Node* copyTree(const Node* source, NodeArena& arena);
+    Node* findOrCreate(uint64_t key, NodeArena& arena);
+    void clearTable();
+    // Keeps the entries whose node survives, as remap gives it; null drops one.
+    void rebuildTable(const std::function<Node*(const Node*)>& remap);
+    bool reserve(size_t moves);
+    // With the search threads stopped. Returns the number of nodes freed.
+    uint64_t prune();
+    
+    // One playout from the root, through rootEdge if given. Moves are made on
+    // the thread's own board and unmade again before returning. Returns false
+    // on a collision. With deferred, a leaf that needs the network is left
+    // there for finishLeaves instead of being evaluated.
+    bool playout(Board& board, AccumulatorStack* stack, NodeArena& arena, Path& path, std::mt19937& rng,
+                 Edge* rootEdge = nullptr, std::vector<Leaf>* deferred = nullptr);
+    // Evaluates the deferred leaves as one batch and completes their playouts.
+    void finishLeaves(std::vector<Leaf>& leaves, NodeArena& arena);
+    // Sequential halving over the Gumbel top-k root moves. Null if the root
+    // is terminal or got proven, leaving the choice to the usual ranking.
+    const Edge* gumbelRoot(const Board& board, int numThreads, std::atomic<uint64_t>& playouts,
+                           std::atomic<uint64_t>& collisions);
+    Edge* select(Node* node, std::mt19937& rng) const;
+    // Expansion up to the evaluation: moves, proofs and priors that need no
+    // network. False if the node turned out terminal, with its result in value.
+    bool startExpansion(Node* node, const Board& board, std::mt19937& rng, Leaf& leaf, float& value);
+    float evaluateLeaf(const Board& board, AccumulatorStack* stack, Leaf& leaf);
+    // Returns the value to back up, from the side that moved into node.
+    float finishExpansion(Node* node, NodeArena& arena, Leaf& leaf);
+    void setPriors(Edge* edges, const std::vector<float>& logits) const;
+    void heuristicLogits(const Board& board, const std::vector<uint16_t>& moves, std::vector<float>& logits) const;
+    void backup(const Path& path, float value);
+    // Proves node from its children if they decide it already.
+    bool solve(Node* node);
+    bool probeTablebases(const Board& board, Proof& proof);
+    bool bestMoveSettled(const Limits& limits, uint64_t playouts, int64_t elapsedMs) const;
+    
+    static float proofValue(Proof proof) { return proof == WON ? 1.0f : proof == LOST ? -1.0f : 0.0f; }
+    
+    static MoveGenerator::Move unpackMove(uint16_t move);
 };
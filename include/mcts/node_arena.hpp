@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for MCTS nodes and edge arrays. Each search thread owns one,
+// so allocation is a pointer increment with no locking, and a whole tree is
+// released by reset() without visiting it. Single allocations can also be
+// recycled onto per-size free lists, which create() draws from first. Only
+// trivially destructible types may live here; their destructors never run.
+class NodeArena {
+public:
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    NodeArena() = default;
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    template<typename T>
+    T* create(size_t count = 1) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        const size_t bytes = count * sizeof(T);
+        void* memory = alignof(T) <= FREE_ALIGNMENT && freeBytes ? reuse(bytes) : nullptr;
+        if (!memory) memory = allocate(bytes, alignof(T));
+        T* first = static_cast<T*>(memory);
+        for (size_t i = 0; i < count; ++i) {
+            new (first + i) T();
+        }
+        return first;
+    }
+
+    // Makes p, from create<T>(count) on this or another arena, available to
+    // later creates of the same size. Recycling into another arena is only
+    // safe while both are reset together.
+    template<typename T>
+    void recycle(T* p, size_t count = 1) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        static_assert(alignof(T) >= FREE_ALIGNMENT && sizeof(T) % FREE_ALIGNMENT == 0);
+        release(p, count * sizeof(T));
+    }
+
+    // Rewinds to the first block and empties the free lists. Blocks are kept
+    // for the next tree.
+    void reset();
+
+    // For arenas recycling into each other, live bytes are the sum of
+    // bytesUsed() less the sum of bytesFree().
+    size_t bytesUsed() const { return used; }
+    size_t bytesFree() const { return freeBytes; }
+    size_t bytesReserved() const { return blocks.size() * BLOCK_SIZE; }
+
+private:
+    static constexpr size_t FREE_ALIGNMENT = alignof(void*);
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    size_t block{0};
+    size_t offset{0};
+    size_t used{0};
+    // Linked through the freed memory itself, indexed by size / FREE_ALIGNMENT.
+    std::vector<void*> freeLists;
+    size_t freeBytes{0};
+
+    void* allocate(size_t bytes, size_t alignment);
+    void* reuse(size_t bytes);
+    void release(void* p, size_t bytes);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "../board/board.hpp"
+#include "features.hpp"
+#include "quantized_network.hpp"
+
+// Per-thread stack of feature transformer accumulators, one entry per ply
+// and perspective. Making a move only records its DirtyPiece; accumulators
+// are brought up to date on evaluation by replaying deltas from the nearest
+// computed ancestor, and unmaking a move just drops the top entry.
+//
+// A king move into another bucket (or across the mirror line) changes every
+// feature of that perspective. Those refreshes go through a per-bucket cache
+// (the "Finny table") holding the last accumulator and pieces seen in that
+// bucket, so only the pieces that differ are added or removed.
+class AccumulatorStack {
+public:
+    explicit AccumulatorStack(const QuantizedNetwork* network = nullptr);
+
+    // Call whenever the network weights change.
+    void setNetwork(const QuantizedNetwork* network);
+
+    void reset(const Board& board);
+    void push(const DirtyPiece& dirty, const Board& board);
+    void pop();
+
+    const QuantizedNetwork::Accumulator& current(const Board& board, int perspective);
+
+    // Output in [-1, 1] from the side to move's point of view.
+    float evaluate(const Board& board);
+
+    int size() const { return top + 1; }
+
+private:
+    static constexpr int INITIAL_PLY = 128;
+
+    struct Entry {
+        alignas(64) std::array<QuantizedNetwork::Accumulator, 2> values;
+        DirtyPiece dirty;
+        std::array<int, 2> kingSquare{};
+        std::array<bool, 2> computed{};
+    };
+
+    struct RefreshEntry {
+        alignas(64) QuantizedNetwork::Accumulator values;
+        std::array<uint64_t, 12> pieces{};
+    };
+
+    const QuantizedNetwork* network;
+    std::vector<Entry> entries;
+    int top{0};
+    std::array<std::array<RefreshEntry, HalfKA::REFRESH_SLOTS>, 2> refreshTable;
+
+    void clearRefreshTable();
+    void refresh(const Board& board, int perspective, Entry& entry);
+    void applyDelta(const Entry& parent, Entry& child, int perspective) const;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Network file compiled into the binary by CHESS_EMBED_NETWORK (see
+// CMakeLists.txt), in the same NetworkFile format as on disk. data() is null
+// and size() zero when the build embedded nothing.
+namespace EmbeddedNetwork {
+    static constexpr const char* NAME = "<embedded>";
+
+    const uint8_t* data();
+    size_t size();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "features.hpp"
+#include "quantized_network.hpp"
+
+// MEMBERS small HalfKA networks evaluated together. Each feature's weight
+// row holds every member's columns back to back, so one addRow/subRow over
+// the row updates all member accumulators and one clippedReLU pass clips
+// them. Only the small dense layers run per member. forward() returns the
+// mean of the member outputs and their variance, which serves as an
+// uncertainty estimate for the position.
+class EnsembleNetwork {
+public:
+    static constexpr int MEMBERS = 4;
+    static constexpr int INPUT_SIZE = HalfKA::INPUT_SIZE;
+    static constexpr int MEMBER_FT_SIZE = 64;
+    static constexpr int FT_SIZE = MEMBERS * MEMBER_FT_SIZE;
+    static constexpr int MEMBER_L2_SIZE = 64;
+
+    static constexpr int FT_SCALE = QuantizedNetwork::FT_SCALE;
+    static constexpr int WEIGHT_SCALE = QuantizedNetwork::WEIGHT_SCALE;
+    static constexpr int WEIGHT_SHIFT = QuantizedNetwork::WEIGHT_SHIFT;
+
+    using Accumulator = std::array<int16_t, FT_SIZE>;
+
+    // Both from the side to move's point of view; outputs lie in [-1, 1].
+    struct Result {
+        float mean;
+        float variance;
+    };
+
+    // Members start from independent random weights.
+    EnsembleNetwork();
+
+    // NetworkFile with this class's architecture hash. On failure the
+    // current weights are kept and error says why.
+    bool loadWeights(const std::string& path, std::string& error);
+    bool saveWeights(const std::string& path) const;
+
+    static constexpr uint64_t architectureHash() {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (uint64_t value : {uint64_t{0x454E53}, uint64_t{MEMBERS}, uint64_t{INPUT_SIZE},
+                               uint64_t{MEMBER_FT_SIZE}, uint64_t{MEMBER_L2_SIZE},
+                               uint64_t{FT_SCALE}, uint64_t{WEIGHT_SCALE}}) {
+            hash = (hash ^ value) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    void refreshAccumulator(const std::array<uint64_t, 12>& pieces, int perspective, Accumulator& accumulator) const;
+    void addFeature(Accumulator& accumulator, int feature) const;
+    void removeFeature(Accumulator& accumulator, int feature) const;
+
+    Result forward(const Accumulator& us, const Accumulator& them) const;
+    Result evaluate(const std::array<uint64_t, 12>& pieces, int sideToMove) const;
+
+private:
+    enum SectionId : uint32_t {
+        FT_WEIGHTS = 1,
+        FT_BIASES,
+        L2_WEIGHTS,
+        L2_BIASES,
+        OUTPUT_WEIGHTS,
+        OUTPUT_BIASES
+    };
+
+    std::vector<int16_t> ftWeights;     // [INPUT_SIZE][MEMBERS][MEMBER_FT_SIZE]
+    std::vector<int16_t> ftBiases;      // [MEMBERS][MEMBER_FT_SIZE]
+    std::vector<int8_t> l2Weights;      // [MEMBERS][MEMBER_L2_SIZE][2][MEMBER_FT_SIZE]
+    std::vector<int32_t> l2Biases;      // [MEMBERS][MEMBER_L2_SIZE]
+    std::vector<int8_t> outputWeights;  // [MEMBERS][MEMBER_L2_SIZE]
+    std::vector<int32_t> outputBiases;  // [MEMBERS]
+
+    void initializeWeights();
+};
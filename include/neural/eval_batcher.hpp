@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "neural_network.hpp"
+
+// Evaluation service for MCTS leaves. Worker threads submit one or several
+// positions and block; one service thread gathers them and runs
+// NeuralNetwork::forwardBatch once the batch is full or maxWait has passed
+// since it started filling. The batch counts as full at maxBatch positions,
+// or as soon as every registered client is waiting, since nothing else can
+// arrive then.
+class EvalBatcher {
+public:
+    static constexpr int DEFAULT_MAX_BATCH = 128;
+    static constexpr std::chrono::microseconds DEFAULT_MAX_WAIT{500};
+
+    struct Stats {
+        uint64_t batches{0};
+        uint64_t positions{0};
+    };
+
+    explicit EvalBatcher(std::shared_ptr<const NetworkWeights> weights,
+                         int maxBatch = DEFAULT_MAX_BATCH,
+                         std::chrono::microseconds maxWait = DEFAULT_MAX_WAIT);
+    ~EvalBatcher();
+    EvalBatcher(const EvalBatcher&) = delete;
+    EvalBatcher& operator=(const EvalBatcher&) = delete;
+
+    // Takes effect from the next batch; batches already running finish on
+    // the old weights.
+    void setWeights(std::shared_ptr<const NetworkWeights> weights);
+
+    // Number of threads that will submit positions concurrently.
+    void setClients(int clients);
+
+    // Same result as NeuralNetwork::evaluate: a hit in the calling thread's
+    // eval cache returns at once, anything else blocks until its batch has run.
+    float evaluate(uint64_t key, const std::array<uint64_t, 12>& pieces, int sideToMove);
+    // With policy logits for moves, as the matching NeuralNetwork::forward.
+    float evaluate(const std::array<uint64_t, 12>& pieces, int sideToMove,
+                   const std::vector<uint16_t>& moves, std::vector<float>& logits);
+    // Several positions submitted at once, so one client can fill a batch.
+    // keys are as above, 0 for none; entries with policy moves take 0.
+    void evaluate(const std::vector<uint64_t>& keys, const std::vector<NeuralNetwork::BatchEntry>& inputs,
+                  std::vector<float>& values);
+
+    int getMaxBatch() const { return maxBatch; }
+
+    Stats getStats();
+
+private:
+    struct Request {
+        NeuralNetwork::BatchEntry input;
+        float result{0.0f};
+        uint64_t salt{0};           // of the weights that produced result
+        int* outstanding{nullptr};  // requests left in its submit call
+    };
+
+    NeuralNetwork network;      // used only by the service thread
+    const int maxBatch;
+    const std::chrono::microseconds maxWait;
+
+    std::mutex mutex;
+    std::condition_variable requestReady;
+    std::condition_variable resultReady;
+    std::vector<Request*> pending;
+    std::shared_ptr<const NetworkWeights> nextWeights;
+    std::atomic<uint64_t> cacheSalt;    // of the newest weights
+    int clients{1};
+    int waiting{0};                 // clients with requests not yet run
+    bool stopping{false};
+    Stats stats;
+    std::thread worker;
+
+    bool batchFull() const;
+    void submit(Request* requests, size_t count);
+    void run();
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// HalfKA input features. Each side's accumulator sees the board from its own
+// perspective: squares are flipped vertically for Black, pieces are split
+// into "ours" and "theirs", and the whole board is mirrored horizontally
+// when that side's king stands on files e-h. Every feature is tied to one of
+// KING_BUCKETS regions of the (oriented, mirrored) king square.
+namespace HalfKA {
+    static constexpr int WHITE = 0;
+    static constexpr int BLACK = 1;
+
+    static constexpr int KING_BUCKETS = 16;
+    static constexpr int PIECE_SQUARES = 12 * 64;
+    static constexpr int INPUT_SIZE = KING_BUCKETS * PIECE_SQUARES;
+
+    // A bucket and a mirror flag fully determine a perspective's feature
+    // indices; a king move between slots forces an accumulator refresh.
+    static constexpr int REFRESH_SLOTS = KING_BUCKETS * 2;
+
+    // Indexed by the king square as seen from its own side (a1 = 0).
+    inline constexpr std::array<int, 64> KING_BUCKET = {
+         0,  1,  2,  3,  3,  2,  1,  0,
+         4,  5,  6,  7,  7,  6,  5,  4,
+         8,  8,  9,  9,  9,  9,  8,  8,
+        10, 10, 11, 11, 11, 11, 10, 10,
+        12, 12, 13, 13, 13, 13, 12, 12,
+        12, 12, 13, 13, 13, 13, 12, 12,
+        14, 14, 15, 15, 15, 15, 14, 14,
+        14, 14, 15, 15, 15, 15, 14, 14
+    };
+
+    constexpr int flip(int perspective) {
+        return perspective == BLACK ? 56 : 0;
+    }
+
+    constexpr int mirror(int kingSquare) {
+        return (kingSquare & 7) >= 4 ? 7 : 0;
+    }
+
+    constexpr int kingBucket(int perspective, int kingSquare) {
+        return KING_BUCKET[kingSquare ^ flip(perspective)];
+    }
+
+    constexpr int refreshSlot(int perspective, int kingSquare) {
+        return kingBucket(perspective, kingSquare) * 2 + (mirror(kingSquare) ? 1 : 0);
+    }
+
+    constexpr bool needsRefresh(int perspective, int fromKingSquare, int toKingSquare) {
+        return refreshSlot(perspective, fromKingSquare) != refreshSlot(perspective, toKingSquare);
+    }
+
+    constexpr int index(int perspective, int kingSquare, int piece, int square) {
+        const int relativePiece = (piece / 6 == perspective ? 0 : 6) + piece % 6;
+        const int orientedSquare = square ^ flip(perspective) ^ mirror(kingSquare);
+        return kingBucket(perspective, kingSquare) * PIECE_SQUARES + relativePiece * 64 + orientedSquare;
+    }
+
+    inline int kingSquare(const std::array<uint64_t, 12>& pieces, int perspective) {
+        const uint64_t king = pieces[perspective * 6 + 5];
+        return king ? std::countr_zero(king) : 0;
+    }
+}
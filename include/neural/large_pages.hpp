@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Owning, 64-byte aligned buffer for large read-only tables. Buffers of at
+// least LARGE_PAGE_SIZE are placed on 2 MB pages when the OS grants them
+// (transparent huge pages on Linux, MEM_LARGE_PAGES on Windows, which needs
+// the "Lock pages in memory" privilege), cutting TLB misses on the weight
+// rows the feature transformer gathers. Anything else gets ordinary pages.
+class LargePageBuffer {
+public:
+    static constexpr size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    LargePageBuffer() = default;
+    explicit LargePageBuffer(size_t bytes);
+    ~LargePageBuffer();
+    LargePageBuffer(LargePageBuffer&& other) noexcept;
+    LargePageBuffer& operator=(LargePageBuffer&& other) noexcept;
+    LargePageBuffer(const LargePageBuffer&) = delete;
+    LargePageBuffer& operator=(const LargePageBuffer&) = delete;
+
+    void* data() const { return base; }
+    size_t size() const { return length; }
+    bool onLargePages() const { return large; }
+
+    // Applies to buffers allocated afterwards.
+    static void setEnabled(bool enabled);
+
+private:
+    void* base{nullptr};
+    size_t length{0};
+    bool large{false};
+
+    static inline std::atomic<bool> enabled{true};
+
+    void release();
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file. Pages are shared through the OS
+// page cache, so every engine process on a host maps the same network.
+class MappedFile {
+public:
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    static std::shared_ptr<MappedFile> open(const std::string& path, std::string& error);
+
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* base{nullptr};
+    size_t length{0};
+#ifdef _WIN32
+    void* fileHandle{nullptr};
+    void* mappingHandle{nullptr};
+#endif
+};
+
+// Versioned container for network weights (little-endian):
+//
+//   Header   magic, version, architecture hash, section count, header CRC
+//   Section  id, CRC32, offset, size            (one per section)
+//   data     each section starts on a SECTION_ALIGNMENT boundary
+//
+// Sections are used in place from the mapping, so loading does no copying.
+namespace NetworkFile {
+    static constexpr std::array<char, 8> MAGIC = {'C', 'H', 'E', 'S', 'S', 'N', 'N', '1'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t SECTION_ALIGNMENT = 64;
+
+    struct Header {
+        std::array<char, 8> magic;
+        uint32_t version;
+        uint32_t sectionCount;
+        uint64_t architectureHash;
+        uint32_t headerCrc;     // over the header (with this field zeroed) and section table
+        uint32_t reserved;
+    };
+
+    struct SectionEntry {
+        uint32_t id;
+        uint32_t crc;           // CRC-32C (Castagnoli)
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Section {
+        uint32_t id;
+        const void* data;
+        size_t size;
+    };
+
+    struct View {
+        std::shared_ptr<MappedFile> mapping;    // null when the data is not file-backed
+        std::vector<Section> sections;
+
+        const Section* find(uint32_t id) const;
+    };
+
+    // CRC-32C; uses the SSE4.2 instruction when the baseline target has it.
+    uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+    bool write(const std::string& path, uint64_t architectureHash, const std::vector<Section>& sections);
+
+    // Validates the header, section bounds and alignment, and (when
+    // verifyChecksums is set) each section's CRC. Sections point into data,
+    // which must outlive the view; name is only used in error messages.
+    bool parse(const uint8_t* data, size_t size, const std::string& name, uint64_t architectureHash,
+               bool verifyChecksums, View& view, std::string& error);
+
+    // parse() over a read-only mapping of path, kept alive by the view.
+    bool open(const std::string& path, uint64_t architectureHash, bool verifyChecksums,
+              View& view, std::string& error);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "features.hpp"
+#include "large_pages.hpp"
+
+// Parameters of the float reference network. Immutable once built and shared
+// by reference count between every NeuralNetwork handle, Evaluator and search
+// thread using them, so a thread or a hosted game only adds its own
+// AccumulatorState. All layers live in one LargePageBuffer.
+//
+// The policy head is optional: a layer from the hidden activations to one
+// logit per from/to square pair, seen from the side to move (squares flipped
+// vertically for Black).
+class NetworkWeights {
+public:
+    static constexpr int INPUT_SIZE = HalfKA::INPUT_SIZE;
+    static constexpr int HIDDEN_SIZE = 512;
+    static constexpr int OUTPUT_SIZE = 1;
+    static constexpr int POLICY_SIZE = 64 * 64;     // row from + 64 * to
+
+    struct Layer {
+        const float* weights;   // input-major: [inputs][outputs]; policy is [outputs][inputs]
+        const float* biases;
+    };
+
+    // He-initialized, untrained weights. Shared by everyone asking while any
+    // holder is alive.
+    static std::shared_ptr<const NetworkWeights> random();
+
+    // Raw little-endian floats, layer by layer, weights before biases, with
+    // the policy layer last if present. Null if the file is missing or has
+    // neither size. Loading a file that is still
+    // held elsewhere in the process (same path and modification time) returns
+    // the existing weights instead of a second copy.
+    static std::shared_ptr<const NetworkWeights> load(const std::string& path);
+
+    const Layer& getInputLayer() const { return inputLayer; }
+    const Layer& getHiddenLayer() const { return hiddenLayer; }
+    const Layer& getOutputLayer() const { return outputLayer; }
+    bool hasPolicy() const { return policyLayer.weights != nullptr; }
+    const Layer& getPolicyLayer() const { return policyLayer; }
+
+    // Mixed into eval cache keys so different weights never share entries.
+    uint64_t getCacheSalt() const { return cacheSalt; }
+
+    size_t bytes() const { return storage.size(); }
+    bool onLargePages() const { return storage.onLargePages(); }
+
+private:
+    static constexpr size_t INPUT_WEIGHTS = static_cast<size_t>(INPUT_SIZE) * HIDDEN_SIZE;
+    static constexpr size_t HIDDEN_WEIGHTS = static_cast<size_t>(2 * HIDDEN_SIZE) * HIDDEN_SIZE;
+    static constexpr size_t OUTPUT_WEIGHTS = static_cast<size_t>(HIDDEN_SIZE) * OUTPUT_SIZE;
+    static constexpr size_t TOTAL_FLOATS =
+        INPUT_WEIGHTS + HIDDEN_SIZE + HIDDEN_WEIGHTS + HIDDEN_SIZE + OUTPUT_WEIGHTS + OUTPUT_SIZE;
+    static constexpr size_t POLICY_FLOATS = static_cast<size_t>(POLICY_SIZE) * HIDDEN_SIZE + POLICY_SIZE;
+
+    explicit NetworkWeights(bool withPolicy);
+
+    float* values() { return static_cast<float*>(storage.data()); }
+
+    LargePageBuffer storage;
+    Layer inputLayer;
+    Layer hiddenLayer;
+    Layer outputLayer;
+    Layer policyLayer{nullptr, nullptr};
+    uint64_t cacheSalt;
+};
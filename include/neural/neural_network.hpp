@@ -5,44 +5,114 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <atomic>
+#include <cmath>
+#include "../eval/eval_cache.hpp"
+#include "features.hpp"
+#include "network_weights.hpp"
 
+// Everything a forward pass writes. One per thread; a few KB, against the
+// ~25 MB of NetworkWeights it reads.
+struct AccumulatorState {
+    std::array<std::vector<float>, 2> accumulators;
+    std::vector<float> transformed;     // [2 * HIDDEN_SIZE], side to move first
+    std::vector<float> hidden;          // [HIDDEN_SIZE]
+    std::vector<float> batchInputs;     // [batch][2 * HIDDEN_SIZE]
+    std::vector<float> batchHidden;     // [batch][HIDDEN_SIZE]
+    
+    AccumulatorState();
+};
+
+// Float reference network: a HalfKA feature transformer shared by both
+// perspectives, whose two halves are concatenated side to move first and
+// fed through a hidden layer to a single tanh output. Weights with a policy
+// head also give a logit per move from the same hidden activations.
+//
+// A NeuralNetwork is a handle: shared, immutable NetworkWeights plus its own
+// AccumulatorState. Copies share the weights, so give each thread its own
+// handle rather than sharing one.
 class NeuralNetwork {
 public:
-    static constexpr int INPUT_SIZE = 768;
-    static constexpr int HIDDEN_SIZE = 512;
-    static constexpr int OUTPUT_SIZE = 1;
+    static constexpr int INPUT_SIZE = NetworkWeights::INPUT_SIZE;
+    static constexpr int HIDDEN_SIZE = NetworkWeights::HIDDEN_SIZE;
+    static constexpr int OUTPUT_SIZE = NetworkWeights::OUTPUT_SIZE;
+    
+    struct BatchEntry {
+        std::array<uint64_t, 12> pieces;
+        int sideToMove;
+        // Optional: moves to score with the policy head, and where to put
+        // their logits.
+        const std::vector<uint16_t>* moves{nullptr};
+        std::vector<float>* logits{nullptr};
+    };
     
+    // Untrained weights, shared with every other default-constructed network.
     NeuralNetwork();
+    explicit NeuralNetwork(std::shared_ptr<const NetworkWeights> weights);
     ~NeuralNetwork() = default;
     
-    void loadWeights(const std::string& path);
-    float forward(const std::array<float, INPUT_SIZE>& input) const;
-    void updateAccumulator(int piece, int square, bool add);
-    void resetAccumulator();
+    // See NetworkWeights::load. Returns false (and keeps the current weights)
+    // if the file is missing or has the wrong size.
+    bool loadWeights(const std::string& path);
+    
+    void setWeights(std::shared_ptr<const NetworkWeights> newWeights);
+    const std::shared_ptr<const NetworkWeights>& getWeights() const { return weights; }
+    
+    // Output in [-1, 1] from the side to move's point of view.
+    float forward(const std::array<uint64_t, 12>& pieces, int sideToMove) {
+        return forward(*weights, state, pieces, sideToMove);
+    }
+    static float forward(const NetworkWeights& weights, AccumulatorState& state,
+                         const std::array<uint64_t, 12>& pieces, int sideToMove);
+    
+    // Also one policy logit per move (Board encoding, promotion ignored);
+    // all 0 if the weights have no policy head.
+    static float forward(const NetworkWeights& weights, AccumulatorState& state,
+                         const std::array<uint64_t, 12>& pieces, int sideToMove,
+                         const std::vector<uint16_t>& moves, std::vector<float>& logits);
+    
+    // forward() over a whole batch. The dense layers run as one matrix
+    // product per layer (CBLAS sgemm when built with CHESS_USE_BLAS).
+    void forwardBatch(const std::vector<BatchEntry>& batch, std::vector<float>& outputs);
+    
+    // Forward pass behind the per-thread eval cache, keyed by the position's
+    // Zobrist hash. A zero key bypasses the cache.
+    float evaluate(uint64_t key, const std::array<uint64_t, 12>& pieces, int sideToMove) {
+        return evaluate(*weights, state, key, pieces, sideToMove);
+    }
+    static float evaluate(const NetworkWeights& weights, AccumulatorState& state, uint64_t key,
+                          const std::array<uint64_t, 12>& pieces, int sideToMove);
+    
+    // The same cache for callers that run the network some other way. salt
+    // is the getCacheSalt() of the weights the value comes from.
+    static bool probeCache(uint64_t key, uint64_t salt, float& value);
+    static void storeCache(uint64_t key, uint64_t salt, float value);
+    
+    static void setCacheSize(size_t sizeKB);
+    // Summed over every thread's cache.
+    static EvalCache<float>::Stats getCacheStats();
     
 private:
-    struct Layer {
-        std::vector<float> weights;
-        std::vector<float> biases;
-        std::vector<float> output;
-        
-        Layer() = default;
-    };
+    static constexpr int MIN_GEMM_BATCH = 4;
     
-    Layer inputLayer;
-    Layer hiddenLayer;
-    Layer outputLayer;
+    std::shared_ptr<const NetworkWeights> weights;
+    AccumulatorState state;
     
-    std::vector<float> accumulator;
-    bool accumulatorValid{false};
+    static inline std::atomic<size_t> cacheSizeKB{EvalCache<float>::DEFAULT_SIZE_KB};
+    static inline std::atomic<uint64_t> cacheHits{0};
+    static inline std::atomic<uint64_t> cacheProbes{0};
+    static EvalCache<float>& threadCache();
     
-    void initializeWeights();
     static float activateReLU(float x) {
         return x > 0.0f ? x : 0.0f;
     }
     static float activateTanh(float x) {
         return std::tanh(x);
     }
-    void computeHiddenLayer(const std::array<float, INPUT_SIZE>& input) const;
-    void computeOutputLayer() const;
+    static void computeFeatureTransformer(const NetworkWeights& weights, AccumulatorState& state,
+                                          const std::array<uint64_t, 12>& pieces, int sideToMove, float* output);
+    static void computeHiddenLayer(const NetworkWeights& weights, AccumulatorState& state);
+    static float computeOutputLayer(const NetworkWeights& weights, const AccumulatorState& state);
+    static void computePolicy(const NetworkWeights& weights, const float* hidden, int sideToMove,
+                              const std::vector<uint16_t>& moves, std::vector<float>& logits);
 };
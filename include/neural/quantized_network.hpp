@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include "neural_network.hpp"
+#include "network_file.hpp"
+#include "large_pages.hpp"
+
+// Integer inference path for NeuralNetwork. The feature transformer keeps
+// int16 weights and accumulators, activations are clipped to [0, 127] and
+// stored as uint8, and the dense layers use int8 weights with int32 sums.
+// Each perspective has its own accumulator over the HalfKA features.
+class QuantizedNetwork {
+public:
+    static constexpr int INPUT_SIZE = NeuralNetwork::INPUT_SIZE;
+    static constexpr int FT_SIZE = NeuralNetwork::HIDDEN_SIZE;
+    static constexpr int L2_INPUT_SIZE = 2 * FT_SIZE;
+    static constexpr int L2_SIZE = NeuralNetwork::HIDDEN_SIZE;
+
+    // An activation of 1.0 is stored as FT_SCALE, a weight of 1.0 as WEIGHT_SCALE.
+    static constexpr int FT_SCALE = 127;
+    static constexpr int WEIGHT_SCALE = 64;
+    static constexpr int WEIGHT_SHIFT = 6;
+
+    // Part of architectureHash(); bump whenever a section's layout changes.
+    static constexpr int WEIGHT_LAYOUT = 2;
+
+    using Accumulator = std::array<int16_t, FT_SIZE>;
+
+    QuantizedNetwork();
+    ~QuantizedNetwork() = default;
+    QuantizedNetwork(const QuantizedNetwork&) = delete;
+    QuantizedNetwork& operator=(const QuantizedNetwork&) = delete;
+
+    void quantize(const NetworkWeights& source);
+
+    // Maps a NetworkFile and uses its sections in place. On failure the
+    // current weights are kept and error says why.
+    bool loadWeights(const std::string& path, std::string& error, bool verifyChecksums = true);
+    // Same, for the network compiled into the binary (see EmbeddedNetwork).
+    bool loadEmbedded(std::string& error, bool verifyChecksums = true);
+    bool saveWeights(const std::string& path) const;
+
+    // Reads a float weights.bin and writes the quantized network to outPath.
+    static bool convertFloatWeights(const std::string& floatPath, const std::string& outPath, std::string& error);
+
+    static constexpr uint64_t architectureHash() {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (uint64_t value : {uint64_t{HalfKA::KING_BUCKETS}, uint64_t{INPUT_SIZE}, uint64_t{FT_SIZE},
+                               uint64_t{L2_INPUT_SIZE}, uint64_t{L2_SIZE}, uint64_t{FT_SCALE}, uint64_t{WEIGHT_SCALE},
+                               uint64_t{WEIGHT_LAYOUT}}) {
+            hash = (hash ^ value) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    void refreshAccumulator(const std::array<uint64_t, 12>& pieces, int perspective, Accumulator& accumulator) const;
+    void addFeature(Accumulator& accumulator, int feature) const;
+    void removeFeature(Accumulator& accumulator, int feature) const;
+    const int16_t* getBiases() const { return ftBiases.data(); }
+
+    // Output in [-1, 1] from the side to move's point of view, like NeuralNetwork::forward.
+    float forward(const Accumulator& us, const Accumulator& them) const;
+    float evaluate(const std::array<uint64_t, 12>& pieces, int sideToMove) const;
+
+private:
+    enum SectionId : uint32_t {
+        FT_WEIGHTS = 1,
+        FT_BIASES,
+        L2_WEIGHTS,
+        L2_BIASES,
+        OUTPUT_WEIGHTS,
+        OUTPUT_BIAS
+    };
+
+    // Owns its values after quantize(), or points into the mapped file.
+    template<typename T>
+    struct Parameter {
+        LargePageBuffer owned;
+        const T* values{nullptr};
+        size_t count;
+
+        explicit Parameter(size_t count) : count(count) { allocate(); }
+
+        T* allocate() {
+            owned = LargePageBuffer(bytes());
+            T* storage = static_cast<T*>(owned.data());
+            std::fill_n(storage, count, T{});
+            values = storage;
+            return storage;
+        }
+
+        void map(const void* data) {
+            owned = {};
+            values = static_cast<const T*>(data);
+        }
+
+        const T& operator[](size_t i) const { return values[i]; }
+        const T* data() const { return values; }
+        size_t bytes() const { return count * sizeof(T); }
+    };
+
+    bool useSections(const NetworkFile::View& view, const std::string& name, std::string& error);
+
+    Parameter<int16_t> ftWeights;
+    Parameter<int16_t> ftBiases;
+    Parameter<int8_t> l2Weights;        // [L2_INPUT_SIZE / 4][L2_SIZE][4]
+    Parameter<int32_t> l2Biases;
+    Parameter<int8_t> outputWeights;
+    Parameter<int32_t> outputBias;
+    std::shared_ptr<MappedFile> mapping;    // null for owned or embedded weights
+};
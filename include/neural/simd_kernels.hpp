@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Vector kernels used by the network code. Each instruction set level is
+// compiled in its own translation unit with matching target flags, and the
+// best level the running CPU supports is picked once on first use, so one
+// binary runs on every x86-64 host. Row lengths must be multiples of 64.
+namespace Simd {
+    enum class Level {
+        SCALAR,
+        SSE41,
+        AVX2,
+        AVX512,
+        AVX512_VNNI
+    };
+
+    struct Kernels {
+        Level level;
+        const char* name;
+
+        // y += a * x
+        void (*axpy)(float* y, const float* x, float a, int n);
+        // out = max(in + bias, 0)
+        void (*biasReLU)(float* out, const float* in, const float* bias, int n);
+
+        void (*addRow)(int16_t* accumulator, const int16_t* row, int n);
+        void (*subRow)(int16_t* accumulator, const int16_t* row, int n);
+        // out = clamp(in, 0, 127)
+        void (*clippedReLU)(uint8_t* out, const int16_t* in, int n);
+        int32_t (*dotProduct)(const uint8_t* input, const int8_t* weights, int n);
+
+        // c = a * b, all row-major: a is m x k, b is k x n, c is m x n
+        void (*gemm)(float* c, const float* a, const float* b, int m, int n, int k);
+
+        // Write the indices of the non-zero floats, or of the non-zero 4-byte
+        // groups, of in to out and return how many there are.
+        int (*nonZeroFloats)(uint16_t* out, const float* in, int n);
+        int (*nonZeroBlocks)(uint16_t* out, const uint8_t* in, int n);
+        // out[j] += in[4b..4b+3] . weights[b][j][0..3] for each listed group b.
+        // weights are [inputs / 4][outputs][4]; outputs must be a multiple of 128.
+        void (*sparseAffine)(int32_t* out, const uint8_t* in, const int8_t* weights,
+                             const uint16_t* blocks, int count, int outputs);
+    };
+
+    // Depth of the slices of b that gemm keeps cache-resident.
+    static constexpr int GEMM_KC = 256;
+
+    extern const Kernels SCALAR_KERNELS;
+#if defined(CHESS_SIMD_X86)
+    extern const Kernels SSE41_KERNELS;
+    extern const Kernels AVX2_KERNELS;
+    extern const Kernels AVX512_KERNELS;
+    extern const Kernels AVX512_VNNI_KERNELS;
+
+    // CRC-32C of words 8-byte words with the SSE4.2 crc32 instruction, crc
+    // neither inverted on the way in nor out. Only when hasCrc32().
+    uint32_t crc32Words(const void* data, size_t words, uint32_t crc);
+#endif
+
+    // Appends base + the position of each set bit of mask.
+    inline int appendSetBits(uint16_t* out, int count, uint32_t mask, int base) {
+        while (mask) {
+            out[count++] = static_cast<uint16_t>(base + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+        return count;
+    }
+
+    Level detect();
+    const Kernels& kernels();
+    bool hasCrc32();
+}
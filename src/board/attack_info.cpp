@@ -0,0 +1,266 @@
+#include "../../include/board/attack_info.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+    constexpr uint64_t FILE_A_BB = 0x0101010101010101ULL;
+    constexpr uint64_t FILE_H_BB = 0x8080808080808080ULL;
+
+    // Directions 0-3 (N, NE, E, NW) increase the square index, 4-7
+    // (S, SW, W, SE) decrease it.
+    constexpr std::array<int, 8> RANK_STEP = {1, 1, 0, 1, -1, -1, 0, -1};
+    constexpr std::array<int, 8> FILE_STEP = {0, 1, 1, -1, 0, -1, -1, 1};
+
+    constexpr std::array<std::array<uint64_t, 64>, 8> buildRays() {
+        std::array<std::array<uint64_t, 64>, 8> rays{};
+        for (int dir = 0; dir < 8; ++dir) {
+            for (int square = 0; square < 64; ++square) {
+                int rank = square / 8 + RANK_STEP[dir];
+                int file = square % 8 + FILE_STEP[dir];
+                while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+                    rays[dir][square] |= 1ULL << (rank * 8 + file);
+                    rank += RANK_STEP[dir];
+                    file += FILE_STEP[dir];
+                }
+            }
+        }
+        return rays;
+    }
+
+    template<size_t N>
+    constexpr std::array<uint64_t, 64> buildLeaper(const std::array<std::array<int, 2>, N>& steps) {
+        std::array<uint64_t, 64> table{};
+        for (int square = 0; square < 64; ++square) {
+            for (const auto& step : steps) {
+                int rank = square / 8 + step[0];
+                int file = square % 8 + step[1];
+                if (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+                    table[square] |= 1ULL << (rank * 8 + file);
+                }
+            }
+        }
+        return table;
+    }
+
+    constexpr auto RAYS = buildRays();
+
+    constexpr auto KNIGHT_TABLE = buildLeaper<8>({{
+        {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+    }});
+
+    constexpr auto KING_TABLE = buildLeaper<8>({{
+        {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+    }});
+
+    inline uint64_t rayAttacks(int dir, int square, uint64_t occupied) {
+        uint64_t attacks = RAYS[dir][square];
+        uint64_t blockers = attacks & occupied;
+        if (blockers) {
+            int blocker = dir < 4 ? __builtin_ctzll(blockers) : 63 - __builtin_clzll(blockers);
+            attacks ^= RAYS[dir][blocker];
+        }
+        return attacks;
+    }
+}
+
+uint64_t Attacks::pawn(int side, int square) {
+    return pawnsSetwise(side, 1ULL << square);
+}
+
+uint64_t Attacks::pawnsSetwise(int side, uint64_t pawns) {
+    if (side == Board::WHITE) {
+        return ((pawns & ~FILE_A_BB) << 7) | ((pawns & ~FILE_H_BB) << 9);
+    }
+    return ((pawns & ~FILE_A_BB) >> 9) | ((pawns & ~FILE_H_BB) >> 7);
+}
+
+uint64_t Attacks::knight(int square) {
+    return KNIGHT_TABLE[square];
+}
+
+uint64_t Attacks::bishop(int square, uint64_t occupied) {
+    return rayAttacks(1, square, occupied) | rayAttacks(3, square, occupied) |
+           rayAttacks(5, square, occupied) | rayAttacks(7, square, occupied);
+}
+
+uint64_t Attacks::rook(int square, uint64_t occupied) {
+    return rayAttacks(0, square, occupied) | rayAttacks(2, square, occupied) |
+           rayAttacks(4, square, occupied) | rayAttacks(6, square, occupied);
+}
+
+uint64_t Attacks::queen(int square, uint64_t occupied) {
+    return bishop(square, occupied) | rook(square, occupied);
+}
+
+uint64_t Attacks::king(int square) {
+    return KING_TABLE[square];
+}
+
+void AttackInfo::compute(const Board& board) {
+    compute(board.pieces, board.occupied, board.sideToMove);
+}
+
+void AttackInfo::compute(const std::array<uint64_t, 12>& pieces, uint64_t occupied, int sideToMove) {
+    *this = AttackInfo{};
+
+    auto add = [this](int side, int type, uint64_t attacks) {
+        doubleAttacks[side] |= bySide[side] & attacks;
+        bySide[side] |= attacks;
+        byPiece[side][type] |= attacks;
+    };
+
+    for (int side = Board::WHITE; side <= Board::BLACK; ++side) {
+        uint64_t kingBB = pieces[side * 6 + Board::KING];
+        kingSquare[side] = kingBB ? __builtin_ctzll(kingBB) : 0;
+        kingZone[side] = kingBB ? Attacks::king(kingSquare[side]) | kingBB : 0;
+
+        uint64_t pawns = pieces[side * 6 + Board::PAWN];
+        uint64_t left = side == Board::WHITE ? (pawns & ~FILE_A_BB) << 7 : (pawns & ~FILE_A_BB) >> 9;
+        uint64_t right = side == Board::WHITE ? (pawns & ~FILE_H_BB) << 9 : (pawns & ~FILE_H_BB) >> 7;
+        add(side, Board::PAWN, left);
+        add(side, Board::PAWN, right);
+    }
+
+    for (int us = Board::WHITE; us <= Board::BLACK; ++us) {
+        const int them = !us;
+        const uint64_t mobilityArea = ~(pieces[us * 6 + Board::PAWN] |
+                                        pieces[us * 6 + Board::KING] |
+                                        byPiece[them][Board::PAWN]);
+
+        kingZoneAttacks[them] += std::popcount(byPiece[us][Board::PAWN] & kingZone[them]);
+
+        for (int type = Board::KNIGHT; type <= Board::KING; ++type) {
+            uint64_t bb = pieces[us * 6 + type];
+            while (bb) {
+                int square = __builtin_ctzll(bb);
+                uint64_t attacks = 0;
+
+                switch (type) {
+                    case Board::KNIGHT: attacks = Attacks::knight(square); break;
+                    case Board::BISHOP: attacks = Attacks::bishop(square, occupied); break;
+                    case Board::ROOK: attacks = Attacks::rook(square, occupied); break;
+                    case Board::QUEEN: attacks = Attacks::queen(square, occupied); break;
+                    case Board::KING: attacks = Attacks::king(square); break;
+                }
+
+                add(us, type, attacks);
+
+                if (type != Board::KING) {
+                    mobility[us][type] += std::popcount(attacks & mobilityArea);
+
+                    uint64_t zone = attacks & kingZone[them];
+                    if (zone) {
+                        kingAttackersCount[them]++;
+                        kingAttackersWeight[them] += KING_ATTACK_WEIGHT[type];
+                        kingZoneAttacks[them] += std::popcount(zone);
+                    }
+                }
+
+                bb &= bb - 1;
+            }
+        }
+    }
+
+    uint64_t enemies = 0;
+    for (int p = 0; p < 6; ++p) {
+        enemies |= pieces[(!sideToMove) * 6 + p];
+    }
+    checkers = isInCheck(sideToMove) ? attackersTo(pieces, kingSquare[sideToMove], occupied) & enemies : 0;
+}
+
+uint64_t AttackInfo::attackersTo(const Board& board, int square, uint64_t occupied) {
+    return attackersTo(board.pieces, square, occupied);
+}
+
+uint64_t AttackInfo::attackersTo(const std::array<uint64_t, 12>& p, int square, uint64_t occupied) {
+    uint64_t diagonal = p[Board::BISHOP] | p[Board::QUEEN] | p[6 + Board::BISHOP] | p[6 + Board::QUEEN];
+    uint64_t straight = p[Board::ROOK] | p[Board::QUEEN] | p[6 + Board::ROOK] | p[6 + Board::QUEEN];
+
+    return (Attacks::pawn(Board::BLACK, square) & p[Board::PAWN]) |
+           (Attacks::pawn(Board::WHITE, square) & p[6 + Board::PAWN]) |
+           (Attacks::knight(square) & (p[Board::KNIGHT] | p[6 + Board::KNIGHT])) |
+           (Attacks::king(square) & (p[Board::KING] | p[6 + Board::KING])) |
+           (Attacks::bishop(square, occupied) & diagonal) |
+           (Attacks::rook(square, occupied) & straight);
+}
+
+uint64_t AttackInfo::between(int from, int to) {
+    const uint64_t fromBB = 1ULL << from;
+    const uint64_t toBB = 1ULL << to;
+    if (Attacks::bishop(from, 0) & toBB) {
+        return Attacks::bishop(from, toBB) & Attacks::bishop(to, fromBB);
+    }
+    if (Attacks::rook(from, 0) & toBB) {
+        return Attacks::rook(from, toBB) & Attacks::rook(to, fromBB);
+    }
+    return 0;
+}
+
+int AttackInfo::see(const Board& board, uint16_t move) const {
+    const int from = move & 0x3F;
+    const int to = (move >> 6) & 0x3F;
+    const int us = board.sideToMove;
+    const auto& p = board.pieces;
+
+    int attacker = board.getPieceAt(from);
+    if (attacker == -1) return 0;
+
+    int victim = board.getPieceAt(to);
+    uint64_t occupied = board.occupied;
+    int gain[32];
+    gain[0] = victim == -1 ? 0 : SEE_VALUE[victim % 6];
+
+    if (victim == -1 && attacker % 6 == Board::PAWN && to == board.enPassantSquare) {
+        gain[0] = SEE_VALUE[Board::PAWN];
+        occupied ^= 1ULL << (to + (us == Board::WHITE ? -8 : 8));
+    }
+
+    uint64_t diagonal = p[Board::BISHOP] | p[Board::QUEEN] | p[6 + Board::BISHOP] | p[6 + Board::QUEEN];
+    uint64_t straight = p[Board::ROOK] | p[Board::QUEEN] | p[6 + Board::ROOK] | p[6 + Board::QUEEN];
+    uint64_t fromSet = 1ULL << from;
+
+    // Undefended target: the only way it can be recaptured is by a slider
+    // uncovered by the moving piece itself.
+    if (!isAttacked(to, !us)) {
+        uint64_t enemies = 0;
+        for (int piece = 0; piece < 6; ++piece) {
+            enemies |= p[(!us) * 6 + piece];
+        }
+        uint64_t after = occupied ^ fromSet;
+        uint64_t xrays = (Attacks::bishop(to, after) & diagonal) | (Attacks::rook(to, after) & straight);
+        if (!(xrays & enemies)) return gain[0];
+    }
+
+    uint64_t attackers = attackersTo(board, to, occupied);
+    int pieceType = attacker % 6;
+    int side = us;
+    int depth = 0;
+
+    do {
+        ++depth;
+        gain[depth] = SEE_VALUE[pieceType] - gain[depth - 1];
+        if (std::max(-gain[depth - 1], gain[depth]) < 0) break;
+
+        attackers ^= fromSet;
+        occupied ^= fromSet;
+        attackers |= (Attacks::bishop(to, occupied) & diagonal) | (Attacks::rook(to, occupied) & straight);
+        attackers &= occupied;
+        side = !side;
+
+        fromSet = 0;
+        for (int type = Board::PAWN; type <= Board::KING; ++type) {
+            uint64_t bb = attackers & p[side * 6 + type];
+            if (bb) {
+                fromSet = bb & (0 - bb);
+                pieceType = type;
+                break;
+            }
+        }
+    } while (fromSet && depth < 31);
+
+    while (--depth) {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    }
+
+    return gain[0];
+}
@@ -1,4 +1,6 @@
 #include "../../include/board/board.hpp"
+#include "../../include/board/attack_info.hpp"
+#include "../../include/neural/accumulator_stack.hpp"
 #include <sstream>
 #include <cctype>
 #include <bitset>
@@ -13,78 +15,46 @@ namespace {
     constexpr uint64_t FILE_A = 0x0101010101010101ULL;
     constexpr uint64_t FILE_H = 0x8080808080808080ULL;
 
-    inline bool isSquareAttacked(const std::array<uint64_t, 12>& pieces, int square, int attackingSide, uint64_t occupied) {
-        uint64_t pawnMask = 1ULL << square;
-        if (attackingSide == Board::WHITE) {
-            pawnMask = ((pawnMask & ~FILE_A) >> 9) | ((pawnMask & ~FILE_H) >> 7);
-            if (pawnMask & pieces[Board::BLACK * 6 + Board::PAWN]) return true;
-        } else {
-            pawnMask = ((pawnMask & ~FILE_A) << 7) | ((pawnMask & ~FILE_H) << 9);
-            if (pawnMask & pieces[Board::WHITE * 6 + Board::PAWN]) return true;
-        }
+    struct ZobristKeys {
+        uint64_t pieces[12][64];
+        uint64_t castling[16];
+        uint64_t enPassant[8];
+        uint64_t side;
+    };
+
+    constexpr uint64_t splitMix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
 
-        uint64_t knightMask = 1ULL << square;
-        uint64_t knightAttacks = ((knightMask & ~FILE_A & ~FILE_B) >> 10) |
-                                ((knightMask & ~FILE_A) >> 17) |
-                                ((knightMask & ~FILE_H) >> 15) |
-                                ((knightMask & ~FILE_G & ~FILE_H) >> 6) |
-                                ((knightMask & ~FILE_A & ~FILE_B) << 6) |
-                                ((knightMask & ~FILE_A) << 15) |
-                                ((knightMask & ~FILE_H) << 17) |
-                                ((knightMask & ~FILE_G & ~FILE_H) << 10);
-        if (knightAttacks & pieces[attackingSide * 6 + Board::KNIGHT]) return true;
-
-        uint64_t bishopAttacks = 0;
-        int sq = square;
-        for (int r = sq + 9; r < 64 && r % 8 > sq % 8; r += 9) {
-            bishopAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        for (int r = sq + 7; r < 64 && r % 8 < sq % 8; r += 7) {
-            bishopAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        for (int r = sq - 7; r >= 0 && r % 8 > sq % 8; r -= 7) {
-            bishopAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        for (int r = sq - 9; r >= 0 && r % 8 < sq % 8; r -= 9) {
-            bishopAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
+    constexpr ZobristKeys buildZobristKeys() {
+        ZobristKeys keys{};
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        for (auto& piece : keys.pieces) {
+            for (auto& key : piece) key = splitMix64(state);
         }
-        if (bishopAttacks & (pieces[attackingSide * 6 + Board::BISHOP] | pieces[attackingSide * 6 + Board::QUEEN])) return true;
+        for (auto& key : keys.castling) key = splitMix64(state);
+        for (auto& key : keys.enPassant) key = splitMix64(state);
+        keys.side = splitMix64(state);
+        return keys;
+    }
 
-        uint64_t rookAttacks = 0;
-        for (int r = sq + 8; r < 64; r += 8) {
-            rookAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        for (int r = sq - 8; r >= 0; r -= 8) {
-            rookAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        for (int r = sq + 1; r % 8 != 0; r++) {
-            rookAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        for (int r = sq - 1; r % 8 != 7 && r >= 0; r--) {
-            rookAttacks |= 1ULL << r;
-            if (occupied & (1ULL << r)) break;
-        }
-        if (rookAttacks & (pieces[attackingSide * 6 + Board::ROOK] | pieces[attackingSide * 6 + Board::QUEEN])) return true;
-
-        uint64_t kingMask = 1ULL << square;
-        uint64_t kingAttacks = ((kingMask & ~FILE_A) >> 1) |
-                              ((kingMask & ~FILE_H) << 1) |
-                              (kingMask << 8) |
-                              (kingMask >> 8) |
-                              ((kingMask & ~FILE_A) >> 9) |
-                              ((kingMask & ~FILE_H) >> 7) |
-                              ((kingMask & ~FILE_A) << 7) |
-                              ((kingMask & ~FILE_H) << 9);
-        if (kingAttacks & pieces[attackingSide * 6 + Board::KING]) return true;
+    constexpr ZobristKeys ZOBRIST = buildZobristKeys();
 
-        return false;
+    inline uint64_t stateKey(int castlingRights, int enPassantSquare) {
+        uint64_t key = ZOBRIST.castling[castlingRights & 15];
+        if (enPassantSquare != -1) key ^= ZOBRIST.enPassant[enPassantSquare & 7];
+        return key;
+    }
+
+    inline uint64_t sidePieces(const std::array<uint64_t, 12>& pieces, int side) {
+        uint64_t bb = 0;
+        for (int piece = 0; piece < 6; ++piece) {
+            bb |= pieces[side * 6 + piece];
+        }
+        return bb;
     }
 }
 
@@ -134,7 +104,21 @@ void Board::setFromFEN(const std::string& fen) {
     halfMoveClock = std::stoi(halfMove);
     fullMoveNumber = std::stoi(fullMove);
 
+    hash ^= stateKey(castlingRights, enPassantSquare);
+    if (sideToMove == BLACK) hash ^= ZOBRIST.side;
+
     updateOccupied();
+
+    if (accumulators.stack) {
+        accumulators.stack->reset(*this);
+    }
+}
+
+void Board::attachAccumulators(AccumulatorStack* stack) {
+    accumulators.stack = stack;
+    if (stack) {
+        stack->reset(*this);
+    }
 }
 
 std::string Board::getFEN() const {
@@ -205,6 +189,9 @@ void Board::clearBoard() {
         bb = 0;
     }
     occupied = 0;
+    hash = 0;
+    psqScore = 0;
+    phase = 0;
     sideToMove = WHITE;
     castlingRights = 0;
     enPassantSquare = -1;
@@ -223,11 +210,33 @@ void Board::updateOccupied() {
 void Board::placePiece(int piece, int square) {
     pieces[piece] |= (1ULL << square);
     occupied |= (1ULL << square);
+    hash ^= ZOBRIST.pieces[piece][square];
+    psqScore += PSQT::get(piece, square);
+    phase += PSQT::PHASE_WEIGHT[piece % 6];
+
+    if (trackingDirty) {
+        if (dirtyPiece.addedCount < DirtyPiece::MAX_CHANGES) {
+            dirtyPiece.added[dirtyPiece.addedCount++] = {piece, square};
+        } else {
+            dirtyPiece.overflow = true;
+        }
+    }
 }
 
 void Board::removePiece(int piece, int square) {
     pieces[piece] &= ~(1ULL << square);
     occupied &= ~(1ULL << square);
+    hash ^= ZOBRIST.pieces[piece][square];
+    psqScore -= PSQT::get(piece, square);
+    phase -= PSQT::PHASE_WEIGHT[piece % 6];
+
+    if (trackingDirty) {
+        if (dirtyPiece.removedCount < DirtyPiece::MAX_CHANGES) {
+            dirtyPiece.removed[dirtyPiece.removedCount++] = {piece, square};
+        } else {
+            dirtyPiece.overflow = true;
+        }
+    }
 }
 
 int Board::getPieceFromChar(char c) {
@@ -257,7 +266,7 @@ bool Board::makeMove(uint16_t move) {
     const int to = (move >> 6) & 0x3F;
     const int promotion = (move >> 12) & 0x7;
 
-    UndoInfo undo{move, castlingRights, enPassantSquare, 0};
+    UndoInfo undo{move, castlingRights, enPassantSquare, halfMoveClock, -1, hash};
 
     int movingPiece = -1;
     for (int p = sideToMove * 6; p < (sideToMove + 1) * 6; ++p) {
@@ -268,9 +277,15 @@ bool Board::makeMove(uint16_t move) {
     }
     if (movingPiece == -1) return false;
 
+    hash ^= stateKey(castlingRights, enPassantSquare);
+
+    dirtyPiece = DirtyPiece{};
+    trackingDirty = accumulators.stack != nullptr;
+
     for (int p = (!sideToMove) * 6; p < (!sideToMove + 1) * 6; ++p) {
         if (pieces[p] & (1ULL << to)) {
             removePiece(p, to);
+            undo.capturedPiece = p;
             break;
         }
     }
@@ -300,21 +315,22 @@ bool Board::makeMove(uint16_t move) {
     if (from == 56 || to == 56) castlingRights &= ~8;
     if (from == 63 || to == 63) castlingRights &= ~4;
 
+    enPassantSquare = -1;
     if (movingPiece % 6 == PAWN) {
         if (abs(to - from) == 16) {
             enPassantSquare = (from + to) / 2;
         } else if (to == undo.enPassantSquare) {
-            removePiece((!sideToMove) * 6 + PAWN, to + (sideToMove ? -8 : 8));
+            removePiece((!sideToMove) * 6 + PAWN, to + (sideToMove ? 8 : -8));
         }
-    } else {
-        enPassantSquare = -1;
     }
 
+    hash ^= stateKey(castlingRights, enPassantSquare) ^ ZOBRIST.side;
+
     if (sideToMove == BLACK) {
         ++fullMoveNumber;
     }
 
-    if (movingPiece % 6 == PAWN || (occupied & (1ULL << to))) {
+    if (movingPiece % 6 == PAWN || undo.capturedPiece != -1) {
         halfMoveClock = 0;
     } else {
         ++halfMoveClock;
@@ -322,6 +338,7 @@ bool Board::makeMove(uint16_t move) {
 
     history.push_back(undo);
     sideToMove = !sideToMove;
+    trackingDirty = false;
 
     int kingSquare = 0;
     uint64_t kingBB = pieces[(!sideToMove) * 6 + KING];
@@ -330,17 +347,28 @@ bool Board::makeMove(uint16_t move) {
         break;
     }
 
-    if (isSquareAttacked(pieces, kingSquare, sideToMove, occupied)) {
-        unmakeMove(move);
+    if (AttackInfo::attackersTo(pieces, kingSquare, occupied) & sidePieces(pieces, sideToMove)) {
+        undoMove(move);
         return false;
     }
 
+    if (accumulators.stack) {
+        accumulators.stack->push(dirtyPiece, *this);
+    }
     return true;
 }
 
 void Board::unmakeMove(uint16_t move) {
     if (history.empty()) return;
 
+    if (accumulators.stack) {
+        accumulators.stack->pop();
+    }
+    undoMove(move);
+}
+
+void Board::undoMove(uint16_t move) {
+
     sideToMove = !sideToMove;
 
     const int from = move & 0x3F;
@@ -364,6 +392,10 @@ void Board::unmakeMove(uint16_t move) {
 
     auto& undo = history.back();
 
+    if (undo.capturedPiece != -1) {
+        placePiece(undo.capturedPiece, to);
+    }
+
     if (movingPiece % 6 == KING) {
         if (from == (sideToMove ? 60 : 4)) {
             if (to == (sideToMove ? 62 : 6)) {
@@ -377,11 +409,13 @@ void Board::unmakeMove(uint16_t move) {
     }
 
     if (movingPiece % 6 == PAWN && to == undo.enPassantSquare) {
-        placePiece((!sideToMove) * 6 + PAWN, to + (sideToMove ? -8 : 8));
+        placePiece((!sideToMove) * 6 + PAWN, to + (sideToMove ? 8 : -8));
     }
 
     castlingRights = undo.castlingRights;
     enPassantSquare = undo.enPassantSquare;
+    halfMoveClock = undo.halfMoveClock;
+    hash = undo.hash;
 
     if (sideToMove == BLACK) {
         --fullMoveNumber;
@@ -398,7 +432,7 @@ bool Board::isInCheck() const {
         break;
     }
 
-    return isSquareAttacked(pieces, kingSquare, !sideToMove, occupied);
+    return AttackInfo::attackersTo(pieces, kingSquare, occupied) & sidePieces(pieces, !sideToMove);
 }
 
 int Board::getSideToMove() const {
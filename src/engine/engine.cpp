@@ -1,15 +1,23 @@
 #include "../../include/engine/engine.hpp"
+#include "../../include/neural/embedded_network.hpp"
+#include "../../include/neural/simd_kernels.hpp"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <iomanip>
 #include <sstream>
 
 ChessEngine::ChessEngine() 
     : network(std::make_shared<NeuralNetwork>())
+    , quantizedNetwork(std::make_shared<QuantizedNetwork>())
+    , ensemble(std::make_shared<EnsembleNetwork>())
+    , accumulators(quantizedNetwork.get())
     , moveGen(std::make_unique<MoveGenerator>())
-    , evaluator(std::make_shared<Evaluator>(network))
+    , evaluator(std::make_shared<Evaluator>(network->getWeights()))
     , mcts(std::make_shared<MCTS>(evaluator))
     , transpositionTable(TT_SIZE)
 {
+    board.attachAccumulators(&accumulators);
 }
 
 void ChessEngine::init() {
@@ -36,6 +44,11 @@ void ChessEngine::setPosition(const std::string& command) {
     std::string fen = extractFEN(command);
     std::string moves = extractMoves(command);
     
+    const std::string previousFen = std::move(gameFen);
+    const std::vector<uint16_t> previousMoves = std::move(gameMoves);
+    gameFen = fen.empty() ? START_FEN : fen;
+    gameMoves.clear();
+    
     if (fen.empty()) {
         setStartPosition();
     } else {
@@ -45,26 +58,221 @@ void ChessEngine::setPosition(const std::string& command) {
     if (!moves.empty()) {
         applyMoves(moves);
     }
+    
+    // GUIs resend the whole game each move, so a position that extends the
+    // last one by our move and the reply keeps that part of the MCTS tree.
+    const bool extendsPrevious = gameFen == previousFen && gameMoves.size() >= previousMoves.size() &&
+                                 std::equal(previousMoves.begin(), previousMoves.end(), gameMoves.begin());
+    if (!extendsPrevious) {
+        mcts->clearTree();
+        return;
+    }
+    for (size_t i = previousMoves.size(); i < gameMoves.size(); ++i) {
+        mcts->advance(gameMoves[i]);
+    }
 }
 
 void ChessEngine::setMultiPV(int) {
 }
 
 void ChessEngine::setThreadCount(int threads) {
-    threadPool.resize(threads);
+    threadPool.resize(std::max(1, threads));
+    mcts->setThreads(threads);
 }
 
 void ChessEngine::loadNetwork(const std::string& path) {
-    network->loadWeights(path);
+    evalFile = path;
+    loadNetworkWeights();
+}
+
+void ChessEngine::loadEnsemble(const std::string& path) {
+    std::string error;
+    
+    // Untrained members disagree at random, so search only consults the
+    // ensemble once real weights are loaded.
+    if (path.empty()) {
+        ensembleLoaded = false;
+    } else if (ensemble->loadWeights(path, error)) {
+        ensembleLoaded = true;
+        std::cout << "info string loaded ensemble " << path << std::endl;
+    } else {
+        ensembleLoaded = false;
+        std::cout << "info string EnsembleFile " << error << "; uncertainty extensions disabled" << std::endl;
+    }
+}
+
+void ChessEngine::setOption(const std::string& command) {
+    std::istringstream iss(command);
+    std::string token;
+    std::string name;
+    std::string value;
+    std::string* target = nullptr;
+    
+    while (iss >> token) {
+        if (token == "name") {
+            target = &name;
+        } else if (token == "value") {
+            target = &value;
+        } else if (target) {
+            if (!target->empty()) *target += " ";
+            *target += token;
+        }
+    }
+    
+    if (name == "Threads") {
+        setThreadCount(std::stoi(value));
+    } else if (name == "EvalCache") {
+        setEvalCacheSize(std::stoul(value));
+    } else if (name == "EvalFile") {
+        loadNetwork(value == "<empty>" ? "" : value);
+    } else if (name == "EnsembleFile") {
+        loadEnsemble(value == "<empty>" ? "" : value);
+    } else if (name == "EvalFileVerify") {
+        verifyEvalFile = value == "true";
+    } else if (name == "UseMCTS") {
+        useNNUE = value != "true";
+    } else if (name == "MCTSTranspositions") {
+        mcts->setTranspositions(value == "true");
+    } else if (name == "MCTSMemory") {
+        mcts->setMemoryLimit(std::stoul(value) << 20);
+    } else if (name == "MCTSPolicy") {
+        mcts->setPolicyMode(value == "heuristic" ? MCTS::POLICY_HEURISTIC
+                            : value == "uniform" ? MCTS::POLICY_UNIFORM
+                                                 : MCTS::POLICY_AUTO);
+    } else if (name == "MCTSGumbel") {
+        mcts->setGumbel(value == "true");
+    } else if (name == "MCTSGumbelSimulations") {
+        mcts->setGumbelSimulations(std::stoi(value));
+    } else if (name == "MCTSBatch") {
+        mctsBatch = value == "true";
+        updateBatcher();
+    } else if (name == "LargePages") {
+        // Applies from the next EvalFile load.
+        LargePageBuffer::setEnabled(value == "true");
+    }
+}
+
+void ChessEngine::setEvalCacheSize(size_t sizeKB) {
+    evalCacheSizeKB = sizeKB;
+    Evaluator::setCacheSize(sizeKB);
+    NeuralNetwork::setCacheSize(sizeKB);
+}
+
+void ChessEngine::printEvalTrace(std::ostream& out) {
+    const Evaluator::Trace trace = evaluator->trace(board);
+    
+    auto row = [&out](const char* term, int value) {
+        out << std::left << std::setw(16) << term << std::right
+            << std::showpos << std::setw(8) << value << std::noshowpos << "\n";
+    };
+    
+    out << std::left << std::setw(16) << "Term" << std::right << std::setw(8) << "cp" << "\n";
+    row("Material", trace.material);
+    row("PST", trace.pst);
+    row("Pawn structure", trace.pawnStructure);
+    row("Mobility", trace.mobility);
+    row("King safety", trace.kingSafety);
+    row("Threats", trace.threats);
+    row("Total", trace.total);
+    out << "Phase " << trace.phase << "/" << PSQT::MAX_PHASE << " (White's point of view)\n";
+    
+    const float sign = board.getSideToMove() == Board::WHITE ? 1.0f : -1.0f;
+    float quantizedOutput = sign * accumulators.evaluate(board);
+    out << "NN output " << std::fixed << std::setprecision(4) << quantizedOutput;
+    if (floatNetworkLoaded) {
+        out << " (fp32 " << sign * network->evaluate(board.getHash(), board.getPieces(), board.getSideToMove()) << ")";
+    }
+    out << "\n";
+    
+    const auto stats = Evaluator::getCacheStats();
+    out << "Eval cache " << stats.hits << "/" << stats.probes << " hits ("
+        << std::setprecision(1) << 100.0 * stats.hitRate() << "%)\n";
+    const auto nnStats = NeuralNetwork::getCacheStats();
+    out << "NN eval cache " << nnStats.hits << "/" << nnStats.probes << " hits ("
+        << std::setprecision(1) << 100.0 * nnStats.hitRate() << "%)" << std::endl;
+}
+
+void ChessEngine::bench(std::ostream& out) {
+    static const std::array<const char*, 6> BENCH_FENS = {
+        START_FEN,
+        "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "2rq1rk1/pp1bppbp/2np1np1/8/3NP3/1BN1BP2/PPPQ2PP/2KR3R b - - 8 11",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"
+    };
+    
+    // The cache would hide the cost of the terms being measured.
+    Evaluator::setCacheSize(0);
+    EvalProfile::reset();
+    
+    Board benchBoard;
+    uint64_t evals = 0;
+    int64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    
+    for (const char* fen : BENCH_FENS) {
+        benchBoard.setFromFEN(fen);
+        const auto moves = benchBoard.generateLegalMoves();
+        
+        for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+            for (uint16_t move : moves) {
+                if (!benchBoard.makeMove(move)) continue;
+                checksum += evaluator->evaluate(benchBoard);
+                ++evals;
+                benchBoard.unmakeMove(move);
+            }
+        }
+    }
+    
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    out << "info string bench evals " << evals << " time " << elapsed << "ms"
+        << " evals/s " << (elapsed ? evals * 1000 / elapsed : 0)
+        << " checksum " << checksum << std::endl;
+    EvalProfile::report(out);
+    
+    Evaluator::setCacheSize(evalCacheSizeKB);
+    
+    AccumulatorStack benchAccumulators(quantizedNetwork.get());
+    benchBoard.attachAccumulators(&benchAccumulators);
+    uint64_t nnEvals = 0;
+    float nnChecksum = 0.0f;
+    const auto nnStart = std::chrono::steady_clock::now();
+    
+    for (const char* fen : BENCH_FENS) {
+        benchBoard.setFromFEN(fen);
+        const auto moves = benchBoard.generateLegalMoves();
+        
+        for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+            for (uint16_t move : moves) {
+                if (!benchBoard.makeMove(move)) continue;
+                nnChecksum += benchAccumulators.evaluate(benchBoard);
+                ++nnEvals;
+                benchBoard.unmakeMove(move);
+            }
+        }
+    }
+    
+    const auto nnElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - nnStart).count();
+    
+    out << "info string bench nnue evals " << nnEvals << " time " << nnElapsed << "ms"
+        << " evals/s " << (nnElapsed ? nnEvals * 1000 / nnElapsed : 0)
+        << " simd " << Simd::kernels().name
+        << " checksum " << std::fixed << std::setprecision(4) << nnChecksum << std::endl;
 }
 
 std::string ChessEngine::getBestMoveNNUE(const std::vector<MoveGenerator::Move>& moves) {
     int bestScore = -INFINITE;
     MoveGenerator::Move bestMove = moves[0];
+    rootPly = pos.ply;
+    rootDepth = calculateSearchDepth();
     
     for (const auto& move : moves) {
-        makeMove(move);
-        int score = -alphaBeta(-INFINITE, INFINITE, calculateSearchDepth(), true);
+        if (!makeMove(move)) continue;
+        int score = -alphaBeta(-INFINITE, INFINITE, rootDepth, true);
         unmakeMove(move);
         
         if (score > bestScore) {
@@ -77,42 +285,91 @@ std::string ChessEngine::getBestMoveNNUE(const std::vector<MoveGenerator::Move>&
 }
 
 std::string ChessEngine::getBestMoveMCTS(const std::vector<MoveGenerator::Move>&) {
-    return moveToString(mcts->getBestMove(pos.pieces, pos.occupied, pos.side, pos.castling, pos.enPassant, 1000));
-}
-
-void ChessEngine::parseTimeControl(const std::string&) {
+    MCTS::Limits limits;
+    limits.timeMs = allocateTimeMs();
+    limits.playouts = timeControl.nodes;
+    const MoveGenerator::Move best = mcts->getBestMove(board, limits);
+    
+    const MCTS::Stats stats = mcts->getStats();
+    std::cout << "info string mcts playouts " << stats.playouts << " reused " << stats.reusedVisits
+              << " transpositions " << stats.transpositions
+              << " tree " << stats.treeBytes / 1024 << " KB memory " << stats.reservedBytes / 1024
+              << " KB pruned " << stats.prunedNodes << " time " << stats.timeMs << " ms";
+    // rootProof is from the opponent's side.
+    if (stats.rootProof == MCTS::LOST) {
+        std::cout << " proven win";
+    } else if (stats.rootProof == MCTS::WON) {
+        std::cout << " proven loss";
+    } else if (stats.rootProof == MCTS::DRAWN) {
+        std::cout << " proven draw";
+    }
+    std::cout << std::endl;
+    return moveToString(best);
 }
 
-void ChessEngine::makeMove(const MoveGenerator::Move& move) {
-    Position oldPos = pos;
-    
-    uint64_t fromBB = 1ULL << move.from;
-    uint64_t toBB = 1ULL << move.to;
+void ChessEngine::parseTimeControl(const std::string& command) {
+    timeControl = {};
+    std::istringstream iss(command);
+    std::string token;
     
-    for (int i = 0; i < 12; ++i) {
-        if (pos.pieces[i] & fromBB) {
-            pos.pieces[i] &= ~fromBB;
-            if (!move.promotion) {
-                pos.pieces[i] |= toBB;
-            }
-            break;
+    while (iss >> token) {
+        if (token == "wtime") {
+            iss >> timeControl.time[0];
+        } else if (token == "btime") {
+            iss >> timeControl.time[1];
+        } else if (token == "winc") {
+            iss >> timeControl.increment[0];
+        } else if (token == "binc") {
+            iss >> timeControl.increment[1];
+        } else if (token == "movestogo") {
+            iss >> timeControl.movesToGo;
+        } else if (token == "movetime") {
+            iss >> timeControl.moveTime;
+        } else if (token == "nodes") {
+            iss >> timeControl.nodes;
         }
     }
-    
-    if (move.promotion) {
-        pos.pieces[pos.side * 6 + move.promotion - 1] |= toBB;
+}
+
+int ChessEngine::allocateTimeMs() const {
+    if (timeControl.moveTime > 0) {
+        return timeControl.moveTime;
     }
     
-    pos.occupied = 0;
-    for (const auto& piece : pos.pieces) {
-        pos.occupied |= piece;
+    const int side = board.getSideToMove();
+    const int left = timeControl.time[side];
+    if (left <= 0) {
+        // "go nodes" alone has no time limit; "go infinite" can't be stopped
+        // by this loop, so it gets the default too.
+        return timeControl.nodes ? 0 : DEFAULT_MOVE_TIME_MS;
     }
     
-    pos.side = !pos.side;
+    const int movesToGo = timeControl.movesToGo > 0 ? timeControl.movesToGo : DEFAULT_MOVES_TO_GO;
+    const int target = left / movesToGo + timeControl.increment[side] * 3 / 4;
+    return std::max(1, std::min(target, left - MOVE_OVERHEAD_MS));
+}
+
+bool ChessEngine::makeMove(const MoveGenerator::Move& move) {
+    // board is what the evaluator reads, so search keeps it in step.
+    if (!board.makeMove(packMove(move))) {
+        return false;
+    }
+    positionHistory.push_back(pos);
+    
+    // Board handles captures, castling and en passant; pos just mirrors it.
+    pos.pieces = board.getPieces();
+    pos.occupied = board.getOccupied();
+    pos.side = board.getSideToMove();
+    pos.castling = board.getCastlingRights();
+    pos.enPassant = board.getEnPassantSquare();
     pos.ply++;
+    return true;
 }
 
-void ChessEngine::unmakeMove(const MoveGenerator::Move&) {
+void ChessEngine::unmakeMove(const MoveGenerator::Move& move) {
+    board.unmakeMove(packMove(move));
+    pos = positionHistory.back();
+    positionHistory.pop_back();
 }
 
 int ChessEngine::alphaBeta(int alpha, int beta, int depth, bool isPV) {
@@ -120,18 +377,20 @@ int ChessEngine::alphaBeta(int alpha, int beta, int depth, bool isPV) {
         return quiescence(alpha, beta);
     }
     
+    depth += uncertaintyAdjustment(depth, isPV);
+    
     std::vector<MoveGenerator::Move> moves = 
         moveGen->generateLegalMoves(pos.pieces, pos.occupied, pos.side, pos.castling, pos.enPassant);
         
     if (moves.empty()) {
-        if (moveGen->isAttacked(pos.pieces[pos.side * 6 + 5], !pos.side, pos.occupied)) {
+        if (board.isInCheck()) {
             return -INFINITE + pos.ply;
         }
         return 0;
     }
     
     for (const auto& move : moves) {
-        makeMove(move);
+        if (!makeMove(move)) continue;
         int score = -alphaBeta(-beta, -alpha, depth - 1, isPV);
         unmakeMove(move);
         
@@ -147,8 +406,26 @@ int ChessEngine::alphaBeta(int alpha, int beta, int depth, bool isPV) {
     return alpha;
 }
 
+int ChessEngine::uncertaintyAdjustment(int depth, bool isPV) const {
+    if (!ensembleLoaded || depth < UNCERTAINTY_MIN_DEPTH) {
+        return 0;
+    }
+    
+    const float spread = std::sqrt(ensemble->evaluate(pos.pieces, pos.side).variance);
+    
+    // Extensions keep depth constant along a line, so they are capped by how
+    // far below the root we already are.
+    if (spread > UNCERTAIN_SPREAD && pos.ply - rootPly < rootDepth) {
+        return 1;
+    }
+    if (spread < CONFIDENT_SPREAD && !isPV) {
+        return -1;
+    }
+    return 0;
+}
+
 int ChessEngine::quiescence(int alpha, int beta) {
-    int standPat = evaluator->evaluate(pos.pieces, pos.occupied, pos.side, 0);
+    int standPat = evaluator->evaluate(board, alpha, beta);
     
     if (standPat >= beta) {
         return beta;
@@ -158,16 +435,18 @@ int ChessEngine::quiescence(int alpha, int beta) {
         alpha = standPat;
     }
     
+    // One set of attack maps serves both the generator and SEE.
+    AttackInfo attacks;
+    attacks.compute(board);
     std::vector<MoveGenerator::Move> moves = 
-        moveGen->generateLegalMoves(pos.pieces, pos.occupied, pos.side, pos.castling, pos.enPassant);
+        moveGen->generateCaptures(pos.pieces, pos.occupied, pos.side, pos.enPassant, attacks);
         
     for (const auto& move : moves) {
-        uint64_t toBB = 1ULL << move.to;
-        if (!(pos.occupied & toBB) && !move.promotion) {
+        if (!move.promotion && attacks.see(board, packMove(move)) < 0) {
             continue;
         }
         
-        makeMove(move);
+        if (!makeMove(move)) continue;
         int score = -quiescence(-beta, -alpha);
         unmakeMove(move);
         
@@ -204,6 +483,10 @@ std::string ChessEngine::moveToString(const MoveGenerator::Move& move) const {
     return result;
 }
 
+uint16_t ChessEngine::packMove(const MoveGenerator::Move& move) {
+    return static_cast<uint16_t>(move.from | (move.to << 6) | (move.promotion << 12));
+}
+
 std::string ChessEngine::extractFEN(const std::string& command) const {
     std::istringstream iss(command);
     std::string token;
@@ -247,7 +530,7 @@ std::string ChessEngine::extractMoves(const std::string& command) const {
 }
 
 void ChessEngine::setStartPosition() {
-    setPositionFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    setPositionFromFEN(START_FEN);
 }
 
 void ChessEngine::setPositionFromFEN(const std::string& fen) {
@@ -255,6 +538,8 @@ void ChessEngine::setPositionFromFEN(const std::string& fen) {
     std::string token;
     
     pos = Position();
+    positionHistory.clear();
+    board.setFromFEN(fen);
     
     iss >> token;
     int rank = 7;
@@ -336,7 +621,9 @@ void ChessEngine::applyMoves(const std::string& moves) {
             }
         }
         
-        makeMove(move);
+        if (makeMove(move)) {
+            gameMoves.push_back(packMove(move));
+        }
     }
 }
 
@@ -349,8 +636,52 @@ void ChessEngine::initializeTranspositionTable() {
 }
 
 void ChessEngine::loadNetworkWeights() {
-    const std::string defaultWeightsPath = "weights.bin";
-    network->loadWeights(defaultWeightsPath);
+    std::string error;
+    floatNetworkLoaded = false;
+    
+    const bool useEmbedded = evalFile.empty() && EmbeddedNetwork::data();
+    const std::string source = useEmbedded ? EmbeddedNetwork::NAME : evalFile.empty() ? DEFAULT_EVAL_FILE : evalFile;
+    const bool loaded = useEmbedded ? quantizedNetwork->loadEmbedded(error, verifyEvalFile)
+                                    : quantizedNetwork->loadWeights(source, error, verifyEvalFile);
+    
+    if (loaded) {
+        std::cout << "info string loaded network " << source << std::endl;
+    } else {
+        // The float weights are only read as a fallback; they are far larger
+        // than the mapped file and must be quantized first.
+        floatNetworkLoaded = network->loadWeights(FLOAT_WEIGHTS_FILE);
+        quantizedNetwork->quantize(*network->getWeights());
+        
+        std::cout << "info string EvalFile " << error << "; "
+                  << (floatNetworkLoaded ? std::string("quantized ") + FLOAT_WEIGHTS_FILE + " instead"
+                                         : std::string("no network weights loaded, NN evaluation is untrained"))
+                  << std::endl;
+    }
+    
+    accumulators.setNetwork(quantizedNetwork.get());
+    evaluator->setNetworkWeights(network->getWeights());
+    mcts->setNetwork(quantizedNetwork.get());
+    updateBatcher();
+    mcts->clearTree();
+}
+
+void ChessEngine::updateBatcher() {
+    // The batcher runs the float network, which is only loaded when the
+    // quantized one is not; batching anything else would mean untrained
+    // weights. Without it, leaves go through the incremental quantized
+    // accumulators.
+    if (!mctsBatch || !floatNetworkLoaded) {
+        if (mctsBatch) {
+            std::cout << "info string MCTSBatch ignored: it needs the float network from " << FLOAT_WEIGHTS_FILE
+                      << ", which is only loaded when the quantized network is not" << std::endl;
+        }
+        evalBatcher = nullptr;
+    } else if (evalBatcher) {
+        evalBatcher->setWeights(network->getWeights());
+    } else {
+        evalBatcher = std::make_shared<EvalBatcher>(network->getWeights());
+    }
+    mcts->setBatcher(evalBatcher);
 }
 
 void ChessEngine::setupThreadPool() {
@@ -1,6 +1,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include "../../include/neural/ensemble_network.hpp"
 
 class HypermodernSystem {
 public:
@@ -26,7 +27,7 @@ public:
 
 private:
     struct SuperNetwork {
-        std::vector<std::unique_ptr<NeuralNetwork>> ensemble;
+        std::unique_ptr<EnsembleNetwork> ensemble;
         std::unique_ptr<TransformerNetwork> transformer;
         std::unique_ptr<AttentionNetwork> attention;
     };
@@ -0,0 +1,55 @@
+#include "../../include/eval/eval_profile.hpp"
+#include <chrono>
+#include <iomanip>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+std::array<EvalProfile::Counter, EvalProfile::TERM_COUNT>& EvalProfile::counters() {
+    static std::array<Counter, TERM_COUNT> instance;
+    return instance;
+}
+
+uint64_t EvalProfile::readCycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+void EvalProfile::reset() {
+    for (auto& counter : counters()) {
+        counter.cycles.store(0, std::memory_order_relaxed);
+        counter.calls.store(0, std::memory_order_relaxed);
+    }
+}
+
+void EvalProfile::report(std::ostream& out) {
+#ifdef EVAL_PROFILE
+    uint64_t total = 0;
+    for (const auto& counter : counters()) {
+        total += counter.cycles.load(std::memory_order_relaxed);
+    }
+
+    out << std::left << std::setw(16) << "Term" << std::right
+        << std::setw(14) << "calls" << std::setw(16) << "cycles"
+        << std::setw(12) << "cyc/call" << std::setw(8) << "%" << "\n";
+
+    for (int term = 0; term < TERM_COUNT; ++term) {
+        uint64_t calls = counters()[term].calls.load(std::memory_order_relaxed);
+        uint64_t cycles = counters()[term].cycles.load(std::memory_order_relaxed);
+
+        out << std::left << std::setw(16) << TERM_NAMES[term] << std::right
+            << std::setw(14) << calls << std::setw(16) << cycles
+            << std::setw(12) << (calls ? cycles / calls : 0)
+            << std::setw(7) << std::fixed << std::setprecision(1)
+            << (total ? 100.0 * static_cast<double>(cycles) / static_cast<double>(total) : 0.0) << "%\n";
+    }
+#else
+    out << "info string eval profiling disabled, rebuild with -DCHESS_EVAL_PROFILE=ON" << "\n";
+#endif
+}
@@ -1,114 +1,165 @@
 #include "../../include/eval/evaluator.hpp"
+#include <algorithm>
 #include <bitset>
 
-int Evaluator::evaluate(const Board& board) {
-    int score = 0;
-    bool endgame = isEndgame(board);
+namespace {
+    AccumulatorState& networkState() {
+        thread_local AccumulatorState state;
+        return state;
+    }
+}
+
+Evaluator::Evaluator(std::shared_ptr<const NetworkWeights> weights)
+    : networkWeights(std::move(weights))
+{
+}
+
+float Evaluator::evaluateNetwork(uint64_t key, const std::array<uint64_t, 12>& pieces, int sideToMove) const {
+    if (!networkWeights) return 0.0f;
     
-    score += getMaterialCount(board);
+    return NeuralNetwork::evaluate(*networkWeights, networkState(), key, pieces, sideToMove);
+}
+
+float Evaluator::evaluateNetwork(const std::array<uint64_t, 12>& pieces, int sideToMove,
+                                 const std::vector<uint16_t>& moves, std::vector<float>& logits) const {
+    if (!networkWeights) {
+        logits.assign(moves.size(), 0.0f);
+        return 0.0f;
+    }
     
-    for (int piece = 0; piece < 12; ++piece) {
-        uint64_t bb = board.pieces[piece];
-        while (bb) {
-            int square = __builtin_ctzll(bb);
-            score += getPieceSquareValue(piece, square, endgame) * (piece < 6 ? 1 : -1);
-            bb &= bb - 1;
-        }
+    return NeuralNetwork::forward(*networkWeights, networkState(), pieces, sideToMove, moves, logits);
+}
+
+void Evaluator::setNetworkWeights(std::shared_ptr<const NetworkWeights> weights) {
+    networkWeights = std::move(weights);
+}
+
+int Evaluator::evaluate(const Board& board) {
+    auto& cache = threadCache();
+    int score;
+    if (cache.probe(board.getHash(), score)) {
+        return score;
+    }
+    
+    AttackInfo attacks;
+    {
+        EVAL_PROFILE_SCOPE(ATTACKS);
+        attacks.compute(board);
     }
+    score = evaluate(board, attacks);
+    
+    cache.store(board.getHash(), score);
+    return score;
+}
+
+int Evaluator::evaluate(const Board& board, const AttackInfo& attacks) {
+    int score = getPsqScore(board);
     
-    score += getMobilityScore(board);
+    score += getMobilityScore(attacks);
     score += getPawnStructureScore(board);
-    score += getKingSafetyScore(board);
+    score += getKingSafetyScore(board, attacks);
+    score += getThreatScore(board, attacks);
     
     return board.getSideToMove() == Board::WHITE ? score : -score;
 }
 
-int Evaluator::getMaterialCount(const Board& board) {
-    int score = 0;
+int Evaluator::evaluate(const Board& board, int alpha, int beta) {
+    const int sign = board.getSideToMove() == Board::WHITE ? 1 : -1;
+    auto& cache = threadCache();
     
-    for (int piece = Board::PAWN; piece <= Board::KING; ++piece) {
-        int whitePieces = std::bitset<64>(board.pieces[piece]).count();
-        int blackPieces = std::bitset<64>(board.pieces[piece + 6]).count();
-        
-        int value;
-        switch (piece) {
-            case Board::PAWN: value = PAWN_VALUE; break;
-            case Board::KNIGHT: value = KNIGHT_VALUE; break;
-            case Board::BISHOP: value = BISHOP_VALUE; break;
-            case Board::ROOK: value = ROOK_VALUE; break;
-            case Board::QUEEN: value = QUEEN_VALUE; break;
-            case Board::KING: value = KING_VALUE; break;
-            default: value = 0;
-        }
-        
-        score += (whitePieces - blackPieces) * value;
+    int score;
+    if (cache.probe(board.getHash(), score)) {
+        return score;
+    }
+    
+    score = sign * getPsqScore(board);
+    if (score + LAZY_MARGIN_PAWNS <= alpha || score - LAZY_MARGIN_PAWNS >= beta) {
+        return score;
+    }
+    
+    score += sign * getPawnStructureScore(board);
+    if (score + LAZY_MARGIN_ATTACKS <= alpha || score - LAZY_MARGIN_ATTACKS >= beta) {
+        return score;
     }
     
+    AttackInfo attacks;
+    {
+        EVAL_PROFILE_SCOPE(ATTACKS);
+        attacks.compute(board);
+    }
+    
+    score += sign * getMobilityScore(attacks);
+    score += sign * getKingSafetyScore(board, attacks);
+    score += sign * getThreatScore(board, attacks);
+    
+    cache.store(board.getHash(), score);
     return score;
 }
 
-bool Evaluator::isEndgame(const Board& board) {
-    int materialCount = 0;
+Evaluator::Trace Evaluator::trace(const Board& board) {
+    Trace result;
+    AttackInfo attacks;
+    attacks.compute(board);
     
+    int materialMg = 0;
+    int materialEg = 0;
     for (int piece = Board::PAWN; piece <= Board::QUEEN; ++piece) {
-        materialCount += std::bitset<64>(board.pieces[piece]).count() * 
-            (piece == Board::PAWN ? PAWN_VALUE : 
-             piece == Board::KNIGHT ? KNIGHT_VALUE :
-             piece == Board::BISHOP ? BISHOP_VALUE :
-             piece == Board::ROOK ? ROOK_VALUE : QUEEN_VALUE);
-        
-        materialCount += std::bitset<64>(board.pieces[piece + 6]).count() * 
-            (piece == Board::PAWN ? PAWN_VALUE : 
-             piece == Board::KNIGHT ? KNIGHT_VALUE :
-             piece == Board::BISHOP ? BISHOP_VALUE :
-             piece == Board::ROOK ? ROOK_VALUE : QUEEN_VALUE);
+        int count = std::bitset<64>(board.pieces[piece]).count() -
+                    std::bitset<64>(board.pieces[piece + 6]).count();
+        materialMg += count * PSQT::PIECE_VALUE_MG[piece];
+        materialEg += count * PSQT::PIECE_VALUE_EG[piece];
     }
     
-    return materialCount <= 2 * ROOK_VALUE + BISHOP_VALUE;
+    result.phase = board.getPhase();
+    result.material = PSQT::taper(PSQT::makeScore(materialMg, materialEg), result.phase);
+    result.pst = getPsqScore(board) - result.material;
+    result.pawnStructure = getPawnStructureScore(board);
+    result.mobility = getMobilityScore(attacks);
+    result.kingSafety = getKingSafetyScore(board, attacks);
+    result.threats = getThreatScore(board, attacks);
+    result.total = result.material + result.pst + result.pawnStructure +
+                   result.mobility + result.kingSafety + result.threats;
+    
+    return result;
 }
 
-int Evaluator::getPieceSquareValue(int piece, int square, bool isEndgame) {
-    if (piece >= 6) {
-        piece -= 6;
-        square = mirrorSquare(square);
-    }
+void Evaluator::setCacheSize(size_t sizeKB) {
+    cacheSizeKB.store(sizeKB, std::memory_order_relaxed);
+}
+
+EvalCache<int>::Stats Evaluator::getCacheStats() {
+    return threadCache().getStats();
+}
+
+EvalCache<int>& Evaluator::threadCache() {
+    thread_local EvalCache<int> cache(0);
     
-    switch (piece) {
-        case Board::PAWN: return PAWN_PST[square];
-        case Board::KNIGHT: return KNIGHT_PST[square];
-        case Board::BISHOP: return BISHOP_PST[square];
-        case Board::ROOK: return ROOK_PST[square];
-        case Board::QUEEN: return QUEEN_PST[square];
-        case Board::KING: return isEndgame ? KING_ENDGAME_PST[square] : KING_PST[square];
-        default: return 0;
+    size_t sizeKB = cacheSizeKB.load(std::memory_order_relaxed);
+    if (cache.sizeKB() != sizeKB) {
+        cache.resize(sizeKB);
     }
+    return cache;
+}
+
+int Evaluator::getPsqScore(const Board& board) {
+    EVAL_PROFILE_SCOPE(PSQ);
+    return PSQT::taper(board.getPsqScore(), board.getPhase());
 }
 
-int Evaluator::getMobilityScore(const Board& board) {
+int Evaluator::getMobilityScore(const AttackInfo& attacks) {
+    EVAL_PROFILE_SCOPE(MOBILITY);
     int score = 0;
-    uint64_t occupied = board.getOccupied();
     
     for (int piece = Board::KNIGHT; piece <= Board::QUEEN; ++piece) {
-        uint64_t whitePieces = board.pieces[piece];
-        uint64_t blackPieces = board.pieces[piece + 6];
-        
-        while (whitePieces) {
-            int square = __builtin_ctzll(whitePieces);
-            score += 5 * std::bitset<64>(board.pieces[piece]).count();
-            whitePieces &= whitePieces - 1;
-        }
-        
-        while (blackPieces) {
-            int square = __builtin_ctzll(blackPieces);
-            score -= 5 * std::bitset<64>(board.pieces[piece + 6]).count();
-            blackPieces &= blackPieces - 1;
-        }
+        score += MOBILITY_WEIGHT[piece] *
+            (attacks.mobility[Board::WHITE][piece] - attacks.mobility[Board::BLACK][piece]);
     }
     
     return score;
 }
 
 int Evaluator::getPawnStructureScore(const Board& board) {
+    EVAL_PROFILE_SCOPE(PAWN_STRUCTURE);
     int score = 0;
     
     uint64_t whitePawns = board.pieces[Board::PAWN];
@@ -116,37 +167,61 @@ int Evaluator::getPawnStructureScore(const Board& board) {
     
     while (whitePawns) {
         int square = __builtin_ctzll(whitePawns);
-        if (isIsolatedPawn(board, square)) score -= 20;
-        if (isDoubledPawn(board, square)) score -= 10;
-        if (isPassedPawn(board, square)) score += 30;
+        if (isIsolatedPawn(board, square)) score -= ISOLATED_PAWN;
+        if (isDoubledPawn(board, square)) score -= DOUBLED_PAWN;
+        if (isPassedPawn(board, square)) score += PASSED_PAWN;
         whitePawns &= whitePawns - 1;
     }
     
     while (blackPawns) {
         int square = __builtin_ctzll(blackPawns);
-        if (isIsolatedPawn(board, square)) score += 20;
-        if (isDoubledPawn(board, square)) score += 10;
-        if (isPassedPawn(board, square)) score -= 30;
+        if (isIsolatedPawn(board, square)) score += ISOLATED_PAWN;
+        if (isDoubledPawn(board, square)) score += DOUBLED_PAWN;
+        if (isPassedPawn(board, square)) score -= PASSED_PAWN;
         blackPawns &= blackPawns - 1;
     }
     
-    score += (getOpenFileCount(board, Board::WHITE) - getOpenFileCount(board, Board::BLACK)) * 10;
-    score += (getSemiOpenFileCount(board, Board::WHITE) - getSemiOpenFileCount(board, Board::BLACK)) * 5;
+    score += (getOpenFileCount(board, Board::WHITE) - getOpenFileCount(board, Board::BLACK)) * OPEN_FILE;
+    score += (getSemiOpenFileCount(board, Board::WHITE) - getSemiOpenFileCount(board, Board::BLACK)) * SEMI_OPEN_FILE;
     
     return score;
 }
 
-int Evaluator::getKingSafetyScore(const Board& board) {
+int Evaluator::getKingSafetyScore(const Board& board, const AttackInfo& attacks) {
+    EVAL_PROFILE_SCOPE(KING_SAFETY);
     int score = 0;
     
     score += getKingShieldScore(board, Board::WHITE);
     score -= getKingShieldScore(board, Board::BLACK);
     
+    score -= getKingDanger(attacks, Board::WHITE);
+    score += getKingDanger(attacks, Board::BLACK);
+    
     return score;
 }
 
-int Evaluator::mirrorSquare(int square) {
-    return square ^ 56;
+int Evaluator::getThreatScore(const Board& board, const AttackInfo& attacks) {
+    EVAL_PROFILE_SCOPE(THREATS);
+    int score = 0;
+    
+    for (int side = Board::WHITE; side <= Board::BLACK; ++side) {
+        const int them = !side;
+        uint64_t pieces = 0;
+        uint64_t nonPawns = 0;
+        
+        for (int piece = Board::PAWN; piece <= Board::QUEEN; ++piece) {
+            pieces |= board.pieces[side * 6 + piece];
+            if (piece != Board::PAWN) nonPawns |= board.pieces[side * 6 + piece];
+        }
+        
+        int threatened = std::bitset<64>(nonPawns & attacks.byPiece[them][Board::PAWN]).count();
+        int hanging = std::bitset<64>(pieces & attacks.bySide[them] & ~attacks.bySide[side]).count();
+        int penalty = std::min(threatened * THREAT_BY_PAWN + hanging * HANGING_PIECE, MAX_THREAT_PENALTY);
+        
+        score += side == Board::WHITE ? -penalty : penalty;
+    }
+    
+    return score;
 }
 
 int Evaluator::getOpenFileCount(const Board& board, int side) {
@@ -237,8 +312,15 @@ int Evaluator::getKingShieldScore(const Board& board, int side) {
         if (kingFile < 7) shield |= 1ULL << (kingSquare + 9 + (side == Board::WHITE ? 8 : -8));
         
         uint64_t pawns = board.pieces[side * 6 + Board::PAWN];
-        score += 10 * std::bitset<64>(shield & pawns).count();
+        score += KING_SHIELD * std::bitset<64>(shield & pawns).count();
     }
     
     return score;
 }
+
+int Evaluator::getKingDanger(const AttackInfo& attacks, int side) {
+    if (attacks.kingAttackersCount[side] < 2) return 0;
+    
+    int units = attacks.kingAttackersWeight[side] + 2 * attacks.kingZoneAttacks[side];
+    return std::min(units * units / 8, MAX_KING_DANGER);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <array>
 #include <vector>
@@ -5,17 +6,42 @@
 #include <iostream>
 #include <string>
 #include <stdexcept>
+#include <thread>
 #include "../include/engine/engine.hpp"
+#include "../include/neural/simd_kernels.hpp"
 
 namespace {
     void printEngineInfo() {
-        std::cout << "id name Chess AI Engine" << std::endl;
+        std::cout << "id name Chess AI Engine (" << Simd::kernels().name << ")" << std::endl;
         std::cout << "id author janebluee" << std::endl;
+        std::cout << "option name Threads type spin default " << std::max(1u, std::thread::hardware_concurrency())
+                  << " min 1 max 1024" << std::endl;
+        std::cout << "option name EvalCache type spin default 256 min 0 max 65536" << std::endl;
+        std::cout << "option name EvalFile type string default <empty>" << std::endl;
+        std::cout << "option name EvalFileVerify type check default true" << std::endl;
+        std::cout << "option name EnsembleFile type string default <empty>" << std::endl;
+        std::cout << "option name LargePages type check default true" << std::endl;
+        std::cout << "option name UseMCTS type check default false" << std::endl;
+        std::cout << "option name MCTSTranspositions type check default false" << std::endl;
+        std::cout << "option name MCTSMemory type spin default 1024 min 0 max 65536" << std::endl;
+        std::cout << "option name MCTSPolicy type combo default auto var auto var heuristic var uniform" << std::endl;
+        std::cout << "option name MCTSGumbel type check default false" << std::endl;
+        std::cout << "option name MCTSGumbelSimulations type spin default 64 min 16 max 200" << std::endl;
+        std::cout << "option name MCTSBatch type check default false" << std::endl;
         std::cout << "uciok" << std::endl;
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc == 4 && std::string(argv[1]) == "convert") {
+        std::string error;
+        if (!QuantizedNetwork::convertFloatWeights(argv[2], argv[3], error)) {
+            std::cerr << "Failed to convert " << argv[2] << ": " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
     try {
         ChessEngine engine;
         engine.init();
@@ -36,9 +62,18 @@ int main() {
                 else if (command == "isready") {
                     std::cout << "readyok" << std::endl;
                 }
+                else if (command.substr(0, 9) == "setoption") {
+                    engine.setOption(command);
+                }
                 else if (command.substr(0, 8) == "position") {
                     engine.setPosition(command);
                 }
+                else if (command == "eval") {
+                    engine.printEvalTrace(std::cout);
+                }
+                else if (command == "bench") {
+                    engine.bench(std::cout);
+                }
                 else if (command.substr(0, 2) == "go") {
                     std::string bestMove = engine.getBestMove(command);
                     std::cout << "bestmove " << bestMove << std::endl;
@@ -1,152 +1,936 @@
 #include "../../include/mcts/mcts.hpp"
 #include "../../include/utils/move_generator.hpp"
+#include "../../include/board/attack_info.hpp"
 #include <cmath>
 #include <algorithm>
+#include <bit>
 #include <chrono>
+#include <limits>
+#include <functional>
 #include <thread>
-#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <numeric>
+#include <utility>
 #include <random>
 
-MCTS::MCTS(std::shared_ptr<Evaluator> eval) : evaluator(eval) {
-    root = std::make_unique<Node>();
+MCTS::MCTS(std::shared_ptr<Evaluator> eval, std::shared_ptr<EvalBatcher> batcher)
+    : evaluator(eval)
+    , batcher(std::move(batcher))
+    , threadCount(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))
+{
 }
 
-MoveGenerator::Move MCTS::getBestMove(const std::array<uint64_t, 12>& pieces,
-                                    uint64_t occupied,
-                                    int side,
-                                    int castling,
-                                    int enPassant,
-                                    int timeMs) {
+MoveGenerator::Move MCTS::getBestMove(const Board& board, const Limits& limits) {
     const auto startTime = std::chrono::steady_clock::now();
-    const int numThreads = std::thread::hardware_concurrency();
+    const int numThreads = threadCount;
     std::vector<std::thread> threads(numThreads);
-    std::atomic<int> iterations{0};
-    std::mutex mtx;
-    
-    auto threadFunc = [&]() {
+    std::atomic<uint64_t> playouts{0};
+    std::atomic<uint64_t> collisions{0};
+
+    prepareTree(board);
+    for (auto& count : history) {
+        count.store(count.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+    }
+    const int reusedVisits = root->visits.load(std::memory_order_relaxed);
+    transpositions.store(0, std::memory_order_relaxed);
+
+    size_t leavesPerThread = 1;
+    if (batcher) {
+        batcher->setClients(numThreads);
+        leavesPerThread = std::max(1, batcher->getMaxBatch() / numThreads);
+    }
+
+    // Threads stop early to let the tree be pruned while pruning still helps.
+    bool pruning = memoryLimit != 0;
+    uint64_t prunedNodes = 0;
+    std::atomic<bool> settled{false};
+    auto elapsedMs = [&] {
+        const auto elapsed = std::chrono::steady_clock::now() - startTime;
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+    };
+    auto outOfBudget = [&] {
+        return settled.load(std::memory_order_relaxed) ||
+               (limits.timeMs && elapsedMs() >= limits.timeMs) ||
+               (limits.playouts && playouts.load(std::memory_order_relaxed) >= limits.playouts);
+    };
+
+    auto threadFunc = [&](NodeArena& arena, AccumulatorStack& stack) {
         std::mt19937 rng(std::random_device{}());
+        Path path;
+        // The only copy: playouts make and unmake moves on it in place.
+        Board threadBoard = board;
+        // With a batcher the accumulators would be kept up to date for nothing.
+        AccumulatorStack* threadStack = network && !batcher ? &stack : nullptr;
+        threadBoard.attachAccumulators(threadStack);
+        std::vector<Leaf> leaves;
+
+        while (!outOfBudget() && !(pruning && memoryFull.load(std::memory_order_relaxed)) &&
+               root->proof.load(std::memory_order_relaxed) == UNPROVEN) {
+            const bool completed = playout(threadBoard, threadStack, arena, path, rng, nullptr,
+                                           batcher ? &leaves : nullptr);
+            if (completed) {
+                const uint64_t done = playouts.fetch_add(1, std::memory_order_relaxed) + 1;
+                if (done % STOP_CHECK_INTERVAL == 0 && bestMoveSettled(limits, done, elapsedMs())) {
+                    settled.store(true, std::memory_order_relaxed);
+                }
+            } else {
+                collisions.fetch_add(1, std::memory_order_relaxed);
+            }
+            // A collision may be with one of this thread's own leaves.
+            if (leaves.size() >= leavesPerThread || (!completed && !leaves.empty())) {
+                finishLeaves(leaves, arena);
+            } else if (!completed) {
+                std::this_thread::yield();
+            }
+        }
+        if (!leaves.empty()) {
+            finishLeaves(leaves, arena);
+        }
+    };
+
+    const Edge* gumbelChoice = nullptr;
+    if (gumbel) {
+        gumbelChoice = gumbelRoot(board, numThreads, playouts, collisions);
+    } else {
         while (true) {
-            auto currentTime = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count() >= timeMs) {
+            memoryFull.store(false, std::memory_order_relaxed);
+            for (int i = 0; i < numThreads; ++i) {
+                threads[i] = std::thread(threadFunc, std::ref(*arenas[i]), std::ref(*accumulators[i]));
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            if (!pruning || !memoryFull.load(std::memory_order_relaxed) || outOfBudget() ||
+                root->proof.load(std::memory_order_relaxed) != UNPROVEN) {
                 break;
             }
-            
-            std::unique_lock<std::mutex> lock(mtx);
-            search(root.get(), pieces, occupied, side, 0, rng);
-            iterations++;
-            lock.unlock();
+            prunedNodes += prune();
+            if (committedBytes.load(std::memory_order_relaxed) > memoryLimit / 4 * 3) {
+                pruning = false;
+            }
         }
-    };
-    
-    for (int i = 0; i < numThreads; ++i) {
-        threads[i] = std::thread(threadFunc);
-    }
-    
-    for (auto& thread : threads) {
-        thread.join();
-    }
-    
-    Node* bestChild = nullptr;
-    float bestValue = -std::numeric_limits<float>::infinity();
-    int totalVisits = 0;
-    
-    for (const auto& child : root->children) {
-        totalVisits += child->visits;
-        float temperature = 1.0f;
-        float childValue = std::pow(static_cast<float>(child->visits), 1.0f / temperature);
-        if (childValue > bestValue) {
-            bestValue = childValue;
-            bestChild = child.get();
-        }
-    }
-    
-    return bestChild ? bestChild->move : MoveGenerator::Move{0, 0, 0};
-}
-
-void MCTS::search(Node* node, const std::array<uint64_t, 12>& pieces,
-                 uint64_t occupied, int side, int depth, std::mt19937& rng) {
-    if (depth >= 1000) return;
-    
-    if (node->children.empty()) {
-        float value = expand(node, pieces, occupied, side, rng);
-        backup(node, value);
+    }
+
+    stats = {playouts.load(), collisions.load(), 0, 0, prunedNodes, reusedVisits, transpositions.load(),
+             root->proof.load(std::memory_order_relaxed), elapsedMs()};
+    for (const auto& arena : arenas) {
+        stats.treeBytes += arena->bytesUsed() - arena->bytesFree();
+        stats.reservedBytes += arena->bytesReserved();
+    }
+
+    if (gumbelChoice) {
+        return unpackMove(gumbelChoice->move);
+    }
+
+    // Proven wins first and proven losses last, then by visits.
+    const Edge* bestEdge = nullptr;
+    std::pair<int, int> bestRank{-1, -1};
+    if (root->state.load(std::memory_order_acquire) == EXPANDED) {
+        for (int i = 0; i < root->edgeCount; ++i) {
+            const Node* child = root->edges[i].child.load(std::memory_order_relaxed);
+            const Proof proof = child ? child->proof.load(std::memory_order_relaxed) : UNPROVEN;
+            const std::pair<int, int> rank{proof == WON ? 2 : proof == LOST ? 0 : 1,
+                                           root->edges[i].visits.load(std::memory_order_relaxed)};
+            if (rank > bestRank) {
+                bestRank = rank;
+                bestEdge = &root->edges[i];
+            }
+        }
+    }
+
+    return bestEdge ? unpackMove(bestEdge->move) : MoveGenerator::Move{0, 0, 0, 0};
+}
+
+void MCTS::advance(uint16_t move) {
+    Node* next = nullptr;
+    if (root && root->state.load(std::memory_order_acquire) == EXPANDED) {
+        for (int i = 0; i < root->edgeCount; ++i) {
+            if (root->edges[i].move == move) {
+                next = root->edges[i].child.load(std::memory_order_acquire);
+                break;
+            }
+        }
+    }
+
+    if (!next) {
+        clearTree();
         return;
     }
-    
-    Node* selectedChild = select(node, rng);
-    selectedChild->visits += VIRTUAL_LOSS;
-    
-    search(selectedChild, pieces, occupied, side ^ 1, depth + 1, rng);
-    
-    selectedChild->visits -= VIRTUAL_LOSS;
+    root = next;
+    rootAdvanced = true;
+}
+
+void MCTS::clearTree() {
+    root = nullptr;
+    rootAdvanced = false;
+}
+
+void MCTS::setThreads(int count) {
+    count = std::max(1, count);
+    if (count == threadCount) return;
+    threadCount = count;
+    // The tree is spread over one arena per thread.
+    clearTree();
+}
+
+void MCTS::setTranspositions(bool enabled, size_t entries) {
+    clearTree();
+    if (!enabled) {
+        table.reset();
+        tableMask = 0;
+        return;
+    }
+
+    const size_t capacity = std::bit_floor(std::max<size_t>(entries, 1024));
+    table = std::make_unique<TableSlot[]>(capacity);
+    tableMask = capacity - 1;
+}
+
+void MCTS::setTablebases(std::shared_ptr<EndgameTablebases> tb) {
+    tablebases = std::move(tb);
+}
+
+void MCTS::setNetwork(const QuantizedNetwork* newNetwork) {
+    network = newNetwork;
+    for (auto& stack : accumulators) {
+        stack->setNetwork(network);
+    }
+}
+
+void MCTS::prepareTree(const Board& board) {
+    // A kept tree implies the thread count is unchanged, so arenas dropped
+    // here hold nothing live.
+    arenas.resize(threadCount);
+    for (auto& arena : arenas) {
+        if (!arena) arena = std::make_unique<NodeArena>();
+    }
+    accumulators.resize(threadCount);
+    for (auto& stack : accumulators) {
+        if (!stack) stack = std::make_unique<AccumulatorStack>(network);
+    }
+
+    if (root && rootAdvanced) {
+        if (!spare) spare = std::make_unique<NodeArena>();
+        spare->reset();
+        root = copyTree(root, *spare);
+        std::swap(arenas[0], spare);
+        spare->reset();
+        for (size_t i = 1; i < arenas.size(); ++i) {
+            arenas[i]->reset();
+        }
+    } else if (!root) {
+        for (auto& arena : arenas) {
+            arena->reset();
+        }
+        clearTable();
+        root = table ? findOrCreate(board.getHash(), *arenas[0]) : arenas[0]->create<Node>();
+        committedBytes.store(sizeof(Node), std::memory_order_relaxed);
+    }
+    rootAdvanced = false;
+}
+
+MCTS::Node* MCTS::copyTree(const Node* source, NodeArena& arena) {
+    // Shared nodes are copied once, and the table is rebuilt to point at
+    // the copies of the nodes that survive.
+    std::unordered_map<const Node*, Node*> copies;
+    auto copyOf = [&](const Node* node, bool& fresh) {
+        fresh = true;
+        if (!table) return arena.create<Node>();
+
+        auto [it, inserted] = copies.try_emplace(node, nullptr);
+        if (!inserted) {
+            fresh = false;
+            return it->second;
+        }
+        return it->second = arena.create<Node>();
+    };
+
+    bool fresh;
+    Node* copy = copyOf(source, fresh);
+    std::vector<std::pair<const Node*, Node*>> pending{{source, copy}};
+    size_t committed = sizeof(Node);
+
+    while (!pending.empty()) {
+        auto [from, to] = pending.back();
+        pending.pop_back();
+
+        to->value.store(from->value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to->visits.store(from->visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to->state.store(from->state.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to->proof.store(from->proof.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to->edgeCount = from->edgeCount;
+        if (from->edgeCount == 0) continue;
+
+        committed += from->edgeCount * BYTES_PER_MOVE;
+        to->edges = arena.create<Edge>(from->edgeCount);
+        for (int i = 0; i < from->edgeCount; ++i) {
+            const Edge& edge = from->edges[i];
+            to->edges[i].move = edge.move;
+            to->edges[i].prior = edge.prior;
+            to->edges[i].visits.store(edge.visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            if (const Node* child = edge.child.load(std::memory_order_relaxed)) {
+                Node* childCopy = copyOf(child, fresh);
+                to->edges[i].child.store(childCopy, std::memory_order_relaxed);
+                if (fresh) pending.push_back({child, childCopy});
+            }
+        }
+    }
+
+    committedBytes.store(committed, std::memory_order_relaxed);
+    rebuildTable([&](const Node* node) {
+        auto found = copies.find(node);
+        return found != copies.end() ? found->second : nullptr;
+    });
+    return copy;
+}
+
+void MCTS::rebuildTable(const std::function<Node*(const Node*)>& remap) {
+    if (!table) return;
+
+    std::vector<std::pair<uint64_t, Node*>> kept;
+    for (size_t i = 0; i <= tableMask; ++i) {
+        if (Node* node = remap(table[i].node.load(std::memory_order_relaxed))) {
+            kept.emplace_back(table[i].key.load(std::memory_order_relaxed), node);
+        }
+    }
+    clearTable();
+    for (const auto& [key, node] : kept) {
+        for (size_t index = key & tableMask;; index = (index + 1) & tableMask) {
+            if (table[index].key.load(std::memory_order_relaxed) == 0) {
+                table[index].key.store(key, std::memory_order_relaxed);
+                table[index].node.store(node, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+}
+
+bool MCTS::reserve(size_t moves) {
+    const size_t bytes = moves * BYTES_PER_MOVE;
+    const size_t committed = committedBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (memoryLimit == 0 || committed <= memoryLimit) return true;
+
+    committedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    memoryFull.store(true, std::memory_order_relaxed);
+    return false;
+}
+
+uint64_t MCTS::prune() {
+    std::vector<Node*> nodes{root};
+    std::unordered_set<const Node*> seen{root};
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (int j = 0; j < nodes[i]->edgeCount; ++j) {
+            Node* child = nodes[i]->edges[j].child.load(std::memory_order_relaxed);
+            if (child && seen.insert(child).second) nodes.push_back(child);
+        }
+    }
+
+    std::vector<int> visits;
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        if (nodes[i]->state.load(std::memory_order_relaxed) == EXPANDED) {
+            visits.push_back(nodes[i]->visits.load(std::memory_order_relaxed));
+        }
+    }
+    if (visits.empty()) return 0;
+    const auto middle = visits.begin() + visits.size() / 2;
+    std::nth_element(visits.begin(), middle, visits.end());
+    const int threshold = *middle;
+
+    // Collapse into leaves; whatever they alone led to becomes unreachable.
+    std::vector<std::pair<Edge*, int>> freedEdges;
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        Node* node = nodes[i];
+        // Playouts stop at proven nodes, so their subtrees are dead weight.
+        if (node->state.load(std::memory_order_relaxed) == EXPANDED &&
+            (node->visits.load(std::memory_order_relaxed) <= threshold ||
+             node->proof.load(std::memory_order_relaxed) != UNPROVEN)) {
+            freedEdges.emplace_back(node->edges, node->edgeCount);
+            node->edges = nullptr;
+            node->edgeCount = 0;
+            node->state.store(UNEXPANDED, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<Node*> live{root};
+    std::unordered_set<const Node*> reachable{root};
+    size_t committed = sizeof(Node);
+    for (size_t i = 0; i < live.size(); ++i) {
+        committed += live[i]->edgeCount * BYTES_PER_MOVE;
+        for (int j = 0; j < live[i]->edgeCount; ++j) {
+            Node* child = live[i]->edges[j].child.load(std::memory_order_relaxed);
+            if (child && reachable.insert(child).second) live.push_back(child);
+        }
+    }
+
+    // Spread over the arenas so every thread has some to reuse.
+    size_t next = 0;
+    for (const auto& [edges, count] : freedEdges) {
+        arenas[next++ % arenas.size()]->recycle(edges, count);
+    }
+    uint64_t freedNodes = 0;
+    for (Node* node : nodes) {
+        if (reachable.count(node)) continue;
+        if (node->edgeCount) {
+            arenas[next++ % arenas.size()]->recycle(node->edges, node->edgeCount);
+        }
+        arenas[next++ % arenas.size()]->recycle(node);
+        ++freedNodes;
+    }
+
+    committedBytes.store(committed, std::memory_order_relaxed);
+    rebuildTable([&](const Node* node) {
+        return reachable.count(node) ? const_cast<Node*>(node) : nullptr;
+    });
+    return freedNodes;
+}
+
+MCTS::Node* MCTS::findOrCreate(uint64_t key, NodeArena& arena) {
+    key = key ? key : 1;
+    size_t index = key & tableMask;
+
+    for (int probe = 0; probe < MAX_PROBES; ++probe, index = (index + 1) & tableMask) {
+        TableSlot& slot = table[index];
+        uint64_t stored = slot.key.load(std::memory_order_acquire);
+
+        if (stored == 0 && slot.key.compare_exchange_strong(stored, key, std::memory_order_acq_rel)) {
+            Node* node = arena.create<Node>();
+            slot.node.store(node, std::memory_order_release);
+            return node;
+        }
+        if (stored == key) {
+            Node* node;
+            while (!(node = slot.node.load(std::memory_order_acquire))) {
+                std::this_thread::yield();
+            }
+            transpositions.fetch_add(1, std::memory_order_relaxed);
+            return node;
+        }
+    }
+
+    // Probe window full: this position just isn't shared.
+    return arena.create<Node>();
+}
+
+void MCTS::clearTable() {
+    for (size_t i = 0; table && i <= tableMask; ++i) {
+        table[i].key.store(0, std::memory_order_relaxed);
+        table[i].node.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool MCTS::playout(Board& board, AccumulatorStack* stack, NodeArena& arena, Path& path, std::mt19937& rng,
+                   Edge* rootEdge, std::vector<Leaf>* deferred) {
+    Node* node = root;
+    path.nodes.assign(1, root);
+    path.edges.clear();
+    float value = 0.0f;
+    bool collided = false;
+    bool leafDeferred = false;
+
+    for (int depth = 0; depth < MAX_DEPTH; ++depth) {
+        const Proof proof = node->proof.load(std::memory_order_acquire);
+        if (proof != UNPROVEN && node != root) {
+            value = proofValue(proof);
+            break;
+        }
+
+        ExpansionState state = node->state.load(std::memory_order_acquire);
+
+        if (state == UNEXPANDED &&
+            node->state.compare_exchange_strong(state, EXPANDING, std::memory_order_acq_rel)) {
+            Leaf leaf;
+            if (startExpansion(node, board, rng, leaf, value)) {
+                if (deferred) {
+                    leaf.path = path;
+                    deferred->push_back(std::move(leaf));
+                    leafDeferred = true;
+                } else {
+                    leaf.value = evaluateLeaf(board, stack, leaf);
+                    value = finishExpansion(node, arena, leaf);
+                }
+            }
+            break;
+        }
+        if (state == EXPANDING) {
+            collided = true;
+            break;
+        }
+        if (state == TERMINAL) {
+            value = proofValue(proof);
+            break;
+        }
+        if (state == EXPANDED) {
+            Edge* edge = node == root && rootEdge ? rootEdge : select(node, rng);
+            if (!board.makeMove(edge->move)) {
+                // Only if move generation let an illegal move through.
+                value = 0.0f;
+                break;
+            }
+
+            Node* child = edge->child.load(std::memory_order_acquire);
+            if (!child) {
+                Node* created = table ? findOrCreate(board.getHash(), arena) : arena.create<Node>();
+                if (edge->child.compare_exchange_strong(child, created, std::memory_order_acq_rel)) {
+                    child = created;
+                } else if (!table) {
+                    arena.recycle(created);
+                }
+            }
+
+            // A position already on this path is a repetition: score it as
+            // a draw instead of cycling.
+            const bool repeated = table && std::find(path.nodes.begin(), path.nodes.end(), child) != path.nodes.end();
+            child->virtualLoss.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+            path.nodes.push_back(child);
+            path.edges.push_back(edge);
+            node = child;
+            if (repeated) {
+                value = 0.0f;
+                break;
+            }
+        }
+        // A lost CAS leaves state holding the winner's value; look again.
+    }
+
+    if (!collided && !leafDeferred) {
+        backup(path, value);
+        // A result proven at the leaf may decide its ancestors in turn.
+        for (size_t i = path.nodes.size(); i-- > 0;) {
+            if (!solve(path.nodes[i])) break;
+        }
+    }
+    if (!leafDeferred) {
+        for (size_t i = 1; i < path.nodes.size(); ++i) {
+            path.nodes[i]->virtualLoss.fetch_sub(VIRTUAL_LOSS, std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = path.edges.size(); i-- > 0;) {
+        board.unmakeMove(path.edges[i]->move);
+    }
+    return !collided;
 }
 
-Node* MCTS::select(Node* node, std::mt19937& rng) {
+void MCTS::finishLeaves(std::vector<Leaf>& leaves, NodeArena& arena) {
+    std::vector<uint64_t> keys;
+    std::vector<NeuralNetwork::BatchEntry> inputs;
+    std::vector<float> values;
+    for (Leaf& leaf : leaves) {
+        if (leaf.networkPolicy) {
+            keys.push_back(0);
+            inputs.push_back({leaf.pieces, leaf.sideToMove, &leaf.moves, &leaf.logits});
+        } else {
+            keys.push_back(leaf.key);
+            inputs.push_back({leaf.pieces, leaf.sideToMove});
+        }
+    }
+    batcher->evaluate(keys, inputs, values);
+
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        const Path& path = leaves[i].path;
+        leaves[i].value = values[i];
+        backup(path, finishExpansion(path.nodes.back(), arena, leaves[i]));
+        for (size_t j = path.nodes.size(); j-- > 0;) {
+            if (!solve(path.nodes[j])) break;
+        }
+        for (size_t j = 1; j < path.nodes.size(); ++j) {
+            path.nodes[j]->virtualLoss.fetch_sub(VIRTUAL_LOSS, std::memory_order_relaxed);
+        }
+    }
+    leaves.clear();
+}
+
+MCTS::Edge* MCTS::select(Node* node, std::mt19937& rng) const {
     float maxValue = -std::numeric_limits<float>::infinity();
-    std::vector<Node*> bestChildren;
-    float parentVisits = static_cast<float>(node->visits + 1);
+    Edge* best = nullptr;
+    int ties = 0;
+    float parentVisits = static_cast<float>(node->visits.load(std::memory_order_relaxed) +
+                                            node->virtualLoss.load(std::memory_order_relaxed) + 1);
     float fpu = -0.2f;
-    
-    for (const auto& child : node->children) {
-        float q = child->visits > 0 ? child->value / child->visits : fpu;
-        float u = C_PUCT * child->prior * std::sqrt(parentVisits) / (1.0f + child->visits);
+
+    for (int i = 0; i < node->edgeCount; ++i) {
+        Edge& edge = node->edges[i];
+        const Node* child = edge.child.load(std::memory_order_acquire);
+
+        // Q comes from every visit to the child, whichever parent it came
+        // through, but only this edge's visits count against exploring it.
+        // Each virtual loss counts as a visit that lost.
+        float q = fpu;
+        int visits = edge.visits.load(std::memory_order_relaxed);
+        const Proof proof = child ? child->proof.load(std::memory_order_relaxed) : UNPROVEN;
+        if (proof == WON) {
+            return &edge;
+        }
+        if (proof == LOST) {
+            continue;
+        }
+        if (proof == DRAWN) {
+            q = 0.0f;
+        } else if (child) {
+            const int pending = child->virtualLoss.load(std::memory_order_relaxed);
+            const int childVisits = child->visits.load(std::memory_order_relaxed) + pending;
+            if (childVisits > 0) {
+                q = (child->value.load(std::memory_order_relaxed) - pending) / childVisits;
+            }
+            visits += pending;
+        }
+        float u = C_PUCT * edge.getPrior() * std::sqrt(parentVisits) / (1.0f + visits);
         float puct = q + u;
-        
+
+        // Ties are broken uniformly (reservoir sampling).
         if (puct > maxValue) {
             maxValue = puct;
-            bestChildren.clear();
-            bestChildren.push_back(child.get());
-        } else if (puct == maxValue) {
-            bestChildren.push_back(child.get());
-        }
-    }
-    
-    if (bestChildren.empty()) return nullptr;
-    
-    std::uniform_int_distribution<size_t> dist(0, bestChildren.size() - 1);
-    return bestChildren[dist(rng)];
-}
-
-float MCTS::expand(Node* node, const std::array<uint64_t, 12>& pieces,
-                  uint64_t occupied, int side, std::mt19937& rng) {
-    float value = std::tanh(evaluator->evaluate(pieces, occupied, side, 0) / 300.0f);
-    
-    MoveGenerator moveGen;
-    std::vector<MoveGenerator::Move> legalMoves = 
-        moveGen.generateLegalMoves(pieces, occupied, side, 0, -1);
-    
-    if (legalMoves.empty()) {
-        return moveGen.isAttacked(pieces[side * 6 + 5], !side, occupied) ? -1.0f : 0.0f;
-    }
-    
+            best = &edge;
+            ties = 1;
+        } else if (puct == maxValue && std::uniform_int_distribution<int>(0, ties++)(rng) == 0) {
+            best = &edge;
+        }
+    }
+
+    // Every move is proven lost; only the root gets searched like that.
+    return best ? best : &node->edges[0];
+}
+
+bool MCTS::startExpansion(Node* node, const Board& board, std::mt19937& rng, Leaf& leaf, float& value) {
+    leaf.moves = board.generateLegalMoves();
+
+    // Proven nodes are leaves for good. The root still needs its moves.
+    Proof proof = UNPROVEN;
+    if (leaf.moves.empty()) {
+        proof = board.isInCheck() ? WON : DRAWN;
+    } else if (node != root) {
+        probeTablebases(board, proof);
+    }
+    if (proof != UNPROVEN) {
+        node->proof.store(proof, std::memory_order_release);
+        node->state.store(TERMINAL, std::memory_order_release);
+        value = proofValue(proof);
+        return false;
+    }
+
+    leaf.pieces = board.getPieces();
+    leaf.sideToMove = board.getSideToMove();
+    leaf.key = board.getHash();
+    leaf.networkPolicy = policyMode == POLICY_AUTO && evaluator->hasNetworkPolicy();
+    if (policyMode == POLICY_UNIFORM) {
+        // Softmax of log(1 + noise) is the old (1 + noise) / sum.
+        std::uniform_real_distribution<float> noiseDist(0.0f, 1.0f);
+        leaf.logits.resize(leaf.moves.size());
+        for (float& logit : leaf.logits) {
+            logit = std::log1p(noiseDist(rng));
+        }
+    } else if (!leaf.networkPolicy) {
+        heuristicLogits(board, leaf.moves, leaf.logits);
+    }
+    return true;
+}
+
+float MCTS::evaluateLeaf(const Board& board, AccumulatorStack* stack, Leaf& leaf) {
+    // Other threads keep selecting while this leaf is evaluated; the
+    // virtual loss on the path steers them elsewhere.
+    if (leaf.networkPolicy) {
+        return batcher ? batcher->evaluate(leaf.pieces, leaf.sideToMove, leaf.moves, leaf.logits)
+                       : evaluator->evaluateNetwork(leaf.pieces, leaf.sideToMove, leaf.moves, leaf.logits);
+    }
+    if (batcher) {
+        return batcher->evaluate(leaf.key, leaf.pieces, leaf.sideToMove);
+    }
+    if (stack) {
+        return stack->evaluate(board);
+    }
+    return evaluator->evaluateNetwork(leaf.key, leaf.pieces, leaf.sideToMove);
+}
+
+float MCTS::finishExpansion(Node* node, NodeArena& arena, Leaf& leaf) {
+    // The root is expanded whatever the budget says.
+    if (node == root) {
+        committedBytes.fetch_add(leaf.moves.size() * BYTES_PER_MOVE, std::memory_order_relaxed);
+    } else if (!reserve(leaf.moves.size())) {
+        // Over budget: stays a leaf, valued by its evaluations alone.
+        node->state.store(UNEXPANDED, std::memory_order_release);
+        return -leaf.value;
+    }
+
+    Edge* edges = arena.create<Edge>(leaf.moves.size());
+    for (size_t i = 0; i < leaf.moves.size(); ++i) {
+        edges[i].move = leaf.moves[i];
+    }
+    setPriors(edges, leaf.logits);
+
+    node->edges = edges;
+    node->edgeCount = static_cast<uint8_t>(leaf.moves.size());
+    node->state.store(EXPANDED, std::memory_order_release);
+    return -leaf.value;
+}
+
+void MCTS::setPriors(Edge* edges, const std::vector<float>& logits) const {
+    const float maxLogit = *std::max_element(logits.begin(), logits.end());
+    std::vector<float> priors(logits.size());
     float priorSum = 0.0f;
-    std::uniform_real_distribution<float> noiseDist(0.0f, 1.0f);
-    
-    for (const auto& move : legalMoves) {
-        auto childNode = std::make_unique<Node>();
-        childNode->move = move;
-        childNode->prior = (1.0f + noiseDist(rng)) / legalMoves.size();
-        childNode->parent = node;
-        priorSum += childNode->prior;
-        node->children.push_back(std::move(childNode));
+    for (size_t i = 0; i < logits.size(); ++i) {
+        priors[i] = std::exp(logits[i] - maxLogit);
+        priorSum += priors[i];
     }
-    
-    if (priorSum > 0.0f) {
-        for (auto& child : node->children) {
-            child->prior /= priorSum;
+
+    // Rounded up to one step so no move is left without exploration.
+    for (size_t i = 0; i < logits.size(); ++i) {
+        const long prior = std::lround(priors[i] / priorSum * PRIOR_SCALE);
+        edges[i].prior = static_cast<uint16_t>(std::max(1L, prior));
+    }
+}
+
+void MCTS::heuristicLogits(const Board& board, const std::vector<uint16_t>& moves, std::vector<float>& logits) const {
+    const int side = board.getSideToMove();
+    const uint64_t occupied = board.getOccupied();
+    const int enemyKing = std::countr_zero(board.getPieces()[(side ^ 1) * 6 + Board::KING]);
+    const int enPassant = board.getEnPassantSquare();
+    logits.resize(moves.size());
+
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const int from = moves[i] & 0x3F;
+        const int to = (moves[i] >> 6) & 0x3F;
+        const int promotion = (moves[i] >> 12) & 0x7;
+        const int piece = board.getPieceAt(from) % 6;
+        int victim = board.getPieceAt(to);
+        if (piece == Board::PAWN && to == enPassant) {
+            victim = Board::PAWN;
+        }
+
+        float logit = HISTORY_LOGIT * std::log1p(static_cast<float>(history[moves[i] & 0xFFF].load(std::memory_order_relaxed)));
+        if (victim >= 0) {
+            // The king's SEE value is a sentinel; as an attacker it risks no more than a queen.
+            const int attacker = std::min(AttackInfo::SEE_VALUE[piece], AttackInfo::SEE_VALUE[Board::QUEEN]);
+            const int gain = AttackInfo::SEE_VALUE[victim % 6] - attacker / 10;
+            logit += CAPTURE_LOGIT + CAPTURE_GAIN_LOGIT * gain;
+        }
+        if (promotion == Board::QUEEN) {
+            logit += PROMOTION_LOGIT;
         }
+
+        // Direct checks only; finding discovered ones would need the move made.
+        const uint64_t after = (occupied & ~(1ULL << from)) | (1ULL << to);
+        uint64_t attacks = 0;
+        switch (promotion ? promotion : piece) {
+            case Board::PAWN: attacks = Attacks::pawn(side, to); break;
+            case Board::KNIGHT: attacks = Attacks::knight(to); break;
+            case Board::BISHOP: attacks = Attacks::bishop(to, after); break;
+            case Board::ROOK: attacks = Attacks::rook(to, after); break;
+            case Board::QUEEN: attacks = Attacks::queen(to, after); break;
+            default: break;
+        }
+        if ((attacks >> enemyKing) & 1) {
+            logit += CHECK_LOGIT;
+        }
+        logits[i] = logit;
     }
-    
-    return -value;
 }
 
-void MCTS::backup(Node* node, float value) {
+void MCTS::backup(const Path& path, float value) {
     float discount = 1.0f;
-    while (node) {
-        node->visits++;
-        node->value += value * discount;
+    for (size_t i = path.nodes.size(); i-- > 0;) {
+        path.nodes[i]->visits.fetch_add(1, std::memory_order_relaxed);
+        path.nodes[i]->value.fetch_add(value * discount, std::memory_order_relaxed);
+        if (i > 0) {
+            path.edges[i - 1]->visits.fetch_add(1, std::memory_order_relaxed);
+            if (value > 0.0f) {
+                history[path.edges[i - 1]->move & 0xFFF].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
         value = -value;
         discount *= 0.99f;
-        node = node->parent;
     }
 }
+
+const MCTS::Edge* MCTS::gumbelRoot(const Board& board, int numThreads, std::atomic<uint64_t>& playouts,
+                                   std::atomic<uint64_t>& collisions) {
+    // Each phase's simulations are handed out from a shared list; every one
+    // is a playout forced through its root move, with PUCT below it.
+    std::vector<Edge*> work;
+    std::atomic<size_t> nextWork{0};
+    auto threadFunc = [&](NodeArena& arena, AccumulatorStack& stack) {
+        std::mt19937 rng(std::random_device{}());
+        Path path;
+        Board threadBoard = board;
+        AccumulatorStack* threadStack = network && !batcher ? &stack : nullptr;
+        threadBoard.attachAccumulators(threadStack);
+
+        for (size_t i; (i = nextWork.fetch_add(1, std::memory_order_relaxed)) < work.size();) {
+            while (!playout(threadBoard, threadStack, arena, path, rng, work[i])) {
+                collisions.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::yield();
+            }
+            playouts.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    auto runWork = [&] {
+        const int count = std::min(numThreads, static_cast<int>(work.size()));
+        if (batcher) {
+            batcher->setClients(count);
+        }
+        nextWork.store(0, std::memory_order_relaxed);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < count; ++i) {
+            threads.emplace_back(threadFunc, std::ref(*arenas[i]), std::ref(*accumulators[i]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    if (root->state.load(std::memory_order_acquire) == UNEXPANDED) {
+        work.assign(1, nullptr);
+        runWork();
+    }
+    if (root->state.load(std::memory_order_acquire) != EXPANDED ||
+        root->proof.load(std::memory_order_relaxed) != UNPROVEN) {
+        return nullptr;
+    }
+
+    // Gumbel noise plus policy logit, then keep the top k: sampling k moves
+    // without replacement from the policy.
+    std::mt19937 rng(std::random_device{}());
+    std::extreme_value_distribution<float> gumbelDist(0.0f, 1.0f);
+    const int edgeCount = root->edgeCount;
+    std::vector<float> score(edgeCount);
+    for (int i = 0; i < edgeCount; ++i) {
+        score[i] = gumbelDist(rng) + std::log(root->edges[i].getPrior());
+    }
+
+    std::vector<int> candidates(edgeCount);
+    std::iota(candidates.begin(), candidates.end(), 0);
+    auto byScore = [&](const std::vector<float>& keys) {
+        return [&keys](int a, int b) { return keys[a] > keys[b]; };
+    };
+    std::sort(candidates.begin(), candidates.end(), byScore(score));
+    // Few enough that every phase can visit each candidate left at least
+    // once with what the root expansion left of the budget.
+    auto simulationsLeft = [&] {
+        return gumbelSimulations - static_cast<int>(playouts.load(std::memory_order_relaxed));
+    };
+    auto phasesFor = [](size_t count) { return static_cast<int>(std::ceil(std::log2(count))); };
+    size_t topK = std::min(edgeCount, GUMBEL_TOP_K);
+    while (topK > 2 && static_cast<int>(topK) * phasesFor(topK) > simulationsLeft()) {
+        --topK;
+    }
+    candidates.resize(topK);
+
+    // Sequential halving: each phase spends an equal share of what is left of
+    // the budget on the candidates left, then drops the worse half by score
+    // plus sigma(q) = (c_visit + max visits) * c_scale * q, with q in [0, 1].
+    // A spent budget ends it early, the candidates ranked as they stand.
+    std::vector<float> ranked(edgeCount);
+    while (candidates.size() > 1) {
+        const int left = simulationsLeft();
+        if (left <= 0) break;
+        const int count = static_cast<int>(candidates.size());
+        const int phasesLeft = phasesFor(count);
+        // The last phase takes all of it; rounding goes to the best candidates first.
+        const int share = phasesLeft == 1 ? left : std::max(std::min(left, count), left / phasesLeft);
+        work.clear();
+        for (int i = 0; i < count; ++i) {
+            work.insert(work.end(), share / count + (i < share % count), &root->edges[candidates[i]]);
+        }
+        runWork();
+
+        int maxVisits = 0;
+        for (int i = 0; i < edgeCount; ++i) {
+            maxVisits = std::max(maxVisits, root->edges[i].visits.load(std::memory_order_relaxed));
+        }
+        for (int candidate : candidates) {
+            const Node* child = root->edges[candidate].child.load(std::memory_order_acquire);
+            float q = 0.0f;
+            if (child && child->proof.load(std::memory_order_relaxed) != UNPROVEN) {
+                q = proofValue(child->proof.load(std::memory_order_relaxed));
+            } else if (child && child->visits.load(std::memory_order_relaxed) > 0) {
+                q = child->value.load(std::memory_order_relaxed) / child->visits.load(std::memory_order_relaxed);
+            }
+            ranked[candidate] = score[candidate] + (GUMBEL_C_VISIT + maxVisits) * GUMBEL_C_SCALE * (q + 1.0f) / 2.0f;
+        }
+        std::sort(candidates.begin(), candidates.end(), byScore(ranked));
+        candidates.resize((candidates.size() + 1) / 2);
+    }
+
+    // A proof found on the way outranks the sampled move.
+    if (root->proof.load(std::memory_order_relaxed) != UNPROVEN) {
+        return nullptr;
+    }
+    return &root->edges[candidates[0]];
+}
+
+bool MCTS::bestMoveSettled(const Limits& limits, uint64_t playouts, int64_t elapsedMs) const {
+    if (root->state.load(std::memory_order_acquire) != EXPANDED) return false;
+
+    // Playouts still to come, at the rate seen so far for a time limit.
+    const int64_t done = static_cast<int64_t>(playouts);
+    int64_t remaining = std::numeric_limits<int64_t>::max();
+    if (limits.playouts) {
+        remaining = static_cast<int64_t>(limits.playouts) - done;
+    }
+    if (limits.timeMs && elapsedMs > 0) {
+        const int64_t left = std::max<int64_t>(limits.timeMs - elapsedMs, 0);
+        remaining = std::min(remaining, done * left / elapsedMs);
+    }
+    if (remaining == std::numeric_limits<int64_t>::max()) return false;
+
+    // Moves proven lost are never chosen, so they don't compete.
+    int first = 0;
+    int second = 0;
+    for (int i = 0; i < root->edgeCount; ++i) {
+        const Node* child = root->edges[i].child.load(std::memory_order_acquire);
+        if (child && child->proof.load(std::memory_order_relaxed) == LOST) continue;
+
+        const int visits = root->edges[i].visits.load(std::memory_order_relaxed);
+        if (visits > first) {
+            second = first;
+            first = visits;
+        } else if (visits > second) {
+            second = visits;
+        }
+    }
+    return first - second > remaining;
+}
+
+bool MCTS::solve(Node* node) {
+    if (node->proof.load(std::memory_order_acquire) != UNPROVEN) return true;
+    if (node->state.load(std::memory_order_acquire) != EXPANDED) return false;
+
+    // Children are proven from the side to move here: one win for it makes
+    // the node lost, and it is won only if every child is lost.
+    bool allProven = true;
+    bool drawn = false;
+    for (int i = 0; i < node->edgeCount; ++i) {
+        const Node* child = node->edges[i].child.load(std::memory_order_acquire);
+        const Proof proof = child ? child->proof.load(std::memory_order_acquire) : UNPROVEN;
+        if (proof == WON) {
+            node->proof.store(LOST, std::memory_order_release);
+            return true;
+        }
+        allProven = allProven && proof != UNPROVEN;
+        drawn = drawn || proof == DRAWN;
+    }
+    if (!allProven) return false;
+
+    node->proof.store(drawn ? DRAWN : WON, std::memory_order_release);
+    return true;
+}
+
+bool MCTS::probeTablebases(const Board& board, Proof& proof) {
+    if (!tablebases || !tablebases->available() ||
+        std::popcount(board.getOccupied()) > tablebases->getMaxPieces()) {
+        return false;
+    }
+
+    int score;
+    {
+        std::lock_guard<std::mutex> lock(tablebaseMutex);
+        if (!tablebases->probeWDL(board, score)) return false;
+    }
+    // score is for the side to move; the proof is for the side that moved.
+    proof = score > 0 ? LOST : score < 0 ? WON : DRAWN;
+    return true;
+}
+
+MoveGenerator::Move MCTS::unpackMove(uint16_t move) {
+    return MoveGenerator::Move{move & 0x3F, (move >> 6) & 0x3F, (move >> 12) & 0x7, 0};
+}
@@ -0,0 +1,52 @@
+#include "../../include/mcts/node_arena.hpp"
+
+void* NodeArena::allocate(size_t bytes, size_t alignment) {
+    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+    if (blocks.empty() || start + bytes > BLOCK_SIZE) {
+        if (bytes > BLOCK_SIZE) throw std::bad_alloc();
+
+        if (blocks.empty() || block + 1 == blocks.size()) {
+            // operator new[] aligns to __STDCPP_DEFAULT_NEW_ALIGNMENT__, enough for nodes and edges.
+            blocks.emplace_back(new std::byte[BLOCK_SIZE]);
+            block = blocks.size() - 1;
+        } else {
+            ++block;
+        }
+        start = 0;
+    }
+
+    used += bytes;
+    offset = start + bytes;
+    return blocks[block].get() + start;
+}
+
+void* NodeArena::reuse(size_t bytes) {
+    const size_t index = bytes / FREE_ALIGNMENT;
+    if (bytes % FREE_ALIGNMENT != 0 || index >= freeLists.size() || !freeLists[index]) {
+        return nullptr;
+    }
+
+    void* p = freeLists[index];
+    freeLists[index] = *static_cast<void**>(p);
+    freeBytes -= bytes;
+    return p;
+}
+
+void NodeArena::release(void* p, size_t bytes) {
+    const size_t index = bytes / FREE_ALIGNMENT;
+    if (index >= freeLists.size()) {
+        freeLists.resize(index + 1, nullptr);
+    }
+
+    *static_cast<void**>(p) = freeLists[index];
+    freeLists[index] = p;
+    freeBytes += bytes;
+}
+
+void NodeArena::reset() {
+    block = 0;
+    offset = 0;
+    used = 0;
+    freeLists.clear();
+    freeBytes = 0;
+}
@@ -0,0 +1,136 @@
+#include "../../include/neural/accumulator_stack.hpp"
+#include <algorithm>
+#include <bit>
+
+AccumulatorStack::AccumulatorStack(const QuantizedNetwork* network)
+    : network(network)
+    , entries(INITIAL_PLY)
+{
+    clearRefreshTable();
+}
+
+void AccumulatorStack::setNetwork(const QuantizedNetwork* newNetwork) {
+    network = newNetwork;
+    for (auto& entry : entries) {
+        entry.computed = {false, false};
+    }
+    clearRefreshTable();
+}
+
+void AccumulatorStack::reset(const Board& board) {
+    top = 0;
+    Entry& root = entries[0];
+    root.dirty = DirtyPiece{};
+    root.computed = {false, false};
+
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        root.kingSquare[perspective] = HalfKA::kingSquare(board.getPieces(), perspective);
+        if (network) {
+            refresh(board, perspective, root);
+        }
+    }
+}
+
+void AccumulatorStack::push(const DirtyPiece& dirty, const Board& board) {
+    if (++top == static_cast<int>(entries.size())) {
+        entries.resize(entries.size() * 2);
+    }
+
+    const Entry& parent = entries[top - 1];
+    Entry& entry = entries[top];
+    entry.dirty = dirty;
+    entry.computed = {false, false};
+
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        entry.kingSquare[perspective] = HalfKA::kingSquare(board.getPieces(), perspective);
+
+        // Deltas cannot carry an accumulator across a bucket change, and the
+        // pieces needed for a refresh are only available now.
+        const bool bucketChanged = HalfKA::needsRefresh(
+            perspective, parent.kingSquare[perspective], entry.kingSquare[perspective]);
+        if ((bucketChanged || dirty.overflow) && network) {
+            refresh(board, perspective, entry);
+        }
+    }
+}
+
+void AccumulatorStack::pop() {
+    if (top > 0) --top;
+}
+
+const QuantizedNetwork::Accumulator& AccumulatorStack::current(const Board& board, int perspective) {
+    Entry& head = entries[top];
+    if (head.computed[perspective]) return head.values[perspective];
+
+    int base = top - 1;
+    while (base >= 0 && !entries[base].computed[perspective]) --base;
+
+    // Nothing to build on (root never refreshed): refresh the top directly.
+    if (base < 0) {
+        refresh(board, perspective, head);
+        return head.values[perspective];
+    }
+
+    for (int ply = base + 1; ply <= top; ++ply) {
+        applyDelta(entries[ply - 1], entries[ply], perspective);
+    }
+    return head.values[perspective];
+}
+
+float AccumulatorStack::evaluate(const Board& board) {
+    const int us = board.getSideToMove();
+    const auto& ours = current(board, us);
+    const auto& theirs = current(board, !us);
+    return network->forward(ours, theirs);
+}
+
+void AccumulatorStack::clearRefreshTable() {
+    for (auto& perspectiveTable : refreshTable) {
+        for (auto& slot : perspectiveTable) {
+            if (network) {
+                std::copy(network->getBiases(), network->getBiases() + QuantizedNetwork::FT_SIZE, slot.values.begin());
+            }
+            slot.pieces = {};
+        }
+    }
+}
+
+void AccumulatorStack::refresh(const Board& board, int perspective, Entry& entry) {
+    const auto& pieces = board.getPieces();
+    const int kingSquare = entry.kingSquare[perspective];
+    RefreshEntry& cached = refreshTable[perspective][HalfKA::refreshSlot(perspective, kingSquare)];
+
+    for (int piece = 0; piece < 12; ++piece) {
+        uint64_t removed = cached.pieces[piece] & ~pieces[piece];
+        uint64_t added = pieces[piece] & ~cached.pieces[piece];
+
+        while (removed) {
+            network->removeFeature(cached.values, HalfKA::index(perspective, kingSquare, piece, std::countr_zero(removed)));
+            removed &= removed - 1;
+        }
+        while (added) {
+            network->addFeature(cached.values, HalfKA::index(perspective, kingSquare, piece, std::countr_zero(added)));
+            added &= added - 1;
+        }
+    }
+
+    cached.pieces = pieces;
+    entry.values[perspective] = cached.values;
+    entry.computed[perspective] = true;
+}
+
+void AccumulatorStack::applyDelta(const Entry& parent, Entry& child, int perspective) const {
+    const int kingSquare = child.kingSquare[perspective];
+    QuantizedNetwork::Accumulator& values = child.values[perspective];
+    values = parent.values[perspective];
+
+    for (int i = 0; i < child.dirty.removedCount; ++i) {
+        const auto& change = child.dirty.removed[i];
+        network->removeFeature(values, HalfKA::index(perspective, kingSquare, change.piece, change.square));
+    }
+    for (int i = 0; i < child.dirty.addedCount; ++i) {
+        const auto& change = child.dirty.added[i];
+        network->addFeature(values, HalfKA::index(perspective, kingSquare, change.piece, change.square));
+    }
+    child.computed[perspective] = true;
+}
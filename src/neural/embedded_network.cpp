@@ -0,0 +1,47 @@
+#include "../../include/neural/embedded_network.hpp"
+
+#ifdef CHESS_EMBEDDED_NETWORK
+
+#if defined(__APPLE__)
+#define EMBED_SYMBOL(name) "_" #name
+#define EMBED_SECTION_BEGIN ".const_data\n"
+#define EMBED_SECTION_END ".text\n"
+#else
+#define EMBED_SYMBOL(name) #name
+#define EMBED_SECTION_BEGIN ".section .rodata\n"
+#define EMBED_SECTION_END ".previous\n"
+#endif
+
+// Section offsets in the file are multiples of NetworkFile::SECTION_ALIGNMENT,
+// so starting the file on that boundary keeps every section aligned in place.
+asm(EMBED_SECTION_BEGIN
+    ".balign 64\n"
+    ".globl " EMBED_SYMBOL(chessEmbeddedNetworkBegin) "\n"
+    EMBED_SYMBOL(chessEmbeddedNetworkBegin) ":\n"
+    ".incbin \"" CHESS_EMBEDDED_NETWORK "\"\n"
+    ".globl " EMBED_SYMBOL(chessEmbeddedNetworkEnd) "\n"
+    EMBED_SYMBOL(chessEmbeddedNetworkEnd) ":\n"
+    EMBED_SECTION_END);
+
+extern "C" const uint8_t chessEmbeddedNetworkBegin[];
+extern "C" const uint8_t chessEmbeddedNetworkEnd[];
+
+const uint8_t* EmbeddedNetwork::data() {
+    return chessEmbeddedNetworkBegin;
+}
+
+size_t EmbeddedNetwork::size() {
+    return static_cast<size_t>(chessEmbeddedNetworkEnd - chessEmbeddedNetworkBegin);
+}
+
+#else
+
+const uint8_t* EmbeddedNetwork::data() {
+    return nullptr;
+}
+
+size_t EmbeddedNetwork::size() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "../../include/neural/ensemble_network.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include "../../include/neural/network_file.hpp"
+#include "../../include/neural/simd_kernels.hpp"
+
+namespace {
+    template<typename T>
+    T quantizeValue(float value, float scale, int limit) {
+        long rounded = std::lround(value * scale);
+        return static_cast<T>(std::clamp<long>(rounded, -limit, limit));
+    }
+
+    template<typename T>
+    size_t bytesOf(const std::vector<T>& values) {
+        return values.size() * sizeof(T);
+    }
+}
+
+EnsembleNetwork::EnsembleNetwork()
+    : ftWeights(static_cast<size_t>(INPUT_SIZE) * FT_SIZE)
+    , ftBiases(FT_SIZE)
+    , l2Weights(MEMBERS * MEMBER_L2_SIZE * 2 * MEMBER_FT_SIZE)
+    , l2Biases(MEMBERS * MEMBER_L2_SIZE)
+    , outputWeights(MEMBERS * MEMBER_L2_SIZE)
+    , outputBiases(MEMBERS)
+{
+    initializeWeights();
+}
+
+void EnsembleNetwork::initializeWeights() {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    constexpr float denseBiasScale = static_cast<float>(FT_SCALE * WEIGHT_SCALE);
+
+    // He initialisation, drawn independently per member so they disagree
+    // until trained.
+    const float ftStd = std::sqrt(2.0f / 32.0f);
+    for (auto& w : ftWeights) w = quantizeValue<int16_t>(dist(gen) * ftStd, FT_SCALE, 32767);
+    for (auto& b : ftBiases) b = quantizeValue<int16_t>(dist(gen) * ftStd, FT_SCALE, 32767);
+
+    const float l2Std = std::sqrt(2.0f / (2 * MEMBER_FT_SIZE));
+    for (auto& w : l2Weights) w = quantizeValue<int8_t>(dist(gen) * l2Std, WEIGHT_SCALE, 127);
+    for (auto& b : l2Biases) b = quantizeValue<int32_t>(dist(gen) * l2Std, denseBiasScale, 1 << 30);
+
+    const float outputStd = std::sqrt(2.0f / MEMBER_L2_SIZE);
+    for (auto& w : outputWeights) w = quantizeValue<int8_t>(dist(gen) * outputStd, WEIGHT_SCALE, 127);
+    for (auto& b : outputBiases) b = 0;
+}
+
+bool EnsembleNetwork::loadWeights(const std::string& path, std::string& error) {
+    NetworkFile::View view;
+    if (!NetworkFile::open(path, architectureHash(), true, view, error)) {
+        return false;
+    }
+
+    auto section = [&](uint32_t id, size_t bytes) -> const void* {
+        const NetworkFile::Section* found = view.find(id);
+        if (!found || found->size != bytes) {
+            error = path + " is missing section " + std::to_string(id) + " or it has the wrong size";
+            return nullptr;
+        }
+        return found->data;
+    };
+
+    const void* ftWeightData = section(FT_WEIGHTS, bytesOf(ftWeights));
+    const void* ftBiasData = section(FT_BIASES, bytesOf(ftBiases));
+    const void* l2WeightData = section(L2_WEIGHTS, bytesOf(l2Weights));
+    const void* l2BiasData = section(L2_BIASES, bytesOf(l2Biases));
+    const void* outputWeightData = section(OUTPUT_WEIGHTS, bytesOf(outputWeights));
+    const void* outputBiasData = section(OUTPUT_BIASES, bytesOf(outputBiases));
+    if (!ftWeightData || !ftBiasData || !l2WeightData || !l2BiasData || !outputWeightData || !outputBiasData) {
+        return false;
+    }
+
+    // Small enough to copy, which lets the mapping go right away.
+    std::memcpy(ftWeights.data(), ftWeightData, bytesOf(ftWeights));
+    std::memcpy(ftBiases.data(), ftBiasData, bytesOf(ftBiases));
+    std::memcpy(l2Weights.data(), l2WeightData, bytesOf(l2Weights));
+    std::memcpy(l2Biases.data(), l2BiasData, bytesOf(l2Biases));
+    std::memcpy(outputWeights.data(), outputWeightData, bytesOf(outputWeights));
+    std::memcpy(outputBiases.data(), outputBiasData, bytesOf(outputBiases));
+    return true;
+}
+
+bool EnsembleNetwork::saveWeights(const std::string& path) const {
+    return NetworkFile::write(path, architectureHash(), {
+        {FT_WEIGHTS, ftWeights.data(), bytesOf(ftWeights)},
+        {FT_BIASES, ftBiases.data(), bytesOf(ftBiases)},
+        {L2_WEIGHTS, l2Weights.data(), bytesOf(l2Weights)},
+        {L2_BIASES, l2Biases.data(), bytesOf(l2Biases)},
+        {OUTPUT_WEIGHTS, outputWeights.data(), bytesOf(outputWeights)},
+        {OUTPUT_BIASES, outputBiases.data(), bytesOf(outputBiases)}
+    });
+}
+
+void EnsembleNetwork::refreshAccumulator(const std::array<uint64_t, 12>& pieces, int perspective,
+                                         Accumulator& accumulator) const {
+    std::copy(ftBiases.begin(), ftBiases.end(), accumulator.begin());
+
+    const int kingSquare = HalfKA::kingSquare(pieces, perspective);
+    for (int piece = 0; piece < 12; ++piece) {
+        uint64_t bb = pieces[piece];
+        while (bb) {
+            addFeature(accumulator, HalfKA::index(perspective, kingSquare, piece, std::countr_zero(bb)));
+            bb &= bb - 1;
+        }
+    }
+}
+
+void EnsembleNetwork::addFeature(Accumulator& accumulator, int feature) const {
+    Simd::kernels().addRow(accumulator.data(), &ftWeights[static_cast<size_t>(feature) * FT_SIZE], FT_SIZE);
+}
+
+void EnsembleNetwork::removeFeature(Accumulator& accumulator, int feature) const {
+    Simd::kernels().subRow(accumulator.data(), &ftWeights[static_cast<size_t>(feature) * FT_SIZE], FT_SIZE);
+}
+
+EnsembleNetwork::Result EnsembleNetwork::forward(const Accumulator& us, const Accumulator& them) const {
+    const Simd::Kernels& simd = Simd::kernels();
+
+    alignas(64) std::array<uint8_t, FT_SIZE> ourInputs;
+    alignas(64) std::array<uint8_t, FT_SIZE> theirInputs;
+    alignas(64) std::array<uint8_t, MEMBER_L2_SIZE> l2Output;
+    simd.clippedReLU(ourInputs.data(), us.data(), FT_SIZE);
+    simd.clippedReLU(theirInputs.data(), them.data(), FT_SIZE);
+
+    std::array<float, MEMBERS> outputs;
+    for (int member = 0; member < MEMBERS; ++member) {
+        const uint8_t* ours = &ourInputs[member * MEMBER_FT_SIZE];
+        const uint8_t* theirs = &theirInputs[member * MEMBER_FT_SIZE];
+
+        for (int out = 0; out < MEMBER_L2_SIZE; ++out) {
+            const int row = member * MEMBER_L2_SIZE + out;
+            const int8_t* weights = &l2Weights[row * 2 * MEMBER_FT_SIZE];
+            int32_t sum = l2Biases[row] +
+                          simd.dotProduct(ours, weights, MEMBER_FT_SIZE) +
+                          simd.dotProduct(theirs, weights + MEMBER_FT_SIZE, MEMBER_FT_SIZE);
+            l2Output[out] = static_cast<uint8_t>(std::clamp(sum >> WEIGHT_SHIFT, 0, FT_SCALE));
+        }
+
+        int32_t sum = outputBiases[member] +
+                      simd.dotProduct(l2Output.data(), &outputWeights[member * MEMBER_L2_SIZE], MEMBER_L2_SIZE);
+        outputs[member] = std::tanh(static_cast<float>(sum) / (FT_SCALE * WEIGHT_SCALE));
+    }
+
+    float mean = 0.0f;
+    for (float output : outputs) mean += output;
+    mean /= MEMBERS;
+
+    float variance = 0.0f;
+    for (float output : outputs) variance += (output - mean) * (output - mean);
+    variance /= MEMBERS;
+
+    return {mean, variance};
+}
+
+EnsembleNetwork::Result EnsembleNetwork::evaluate(const std::array<uint64_t, 12>& pieces, int sideToMove) const {
+    std::array<Accumulator, 2> accumulators;
+    refreshAccumulator(pieces, HalfKA::WHITE, accumulators[HalfKA::WHITE]);
+    refreshAccumulator(pieces, HalfKA::BLACK, accumulators[HalfKA::BLACK]);
+    return forward(accumulators[sideToMove], accumulators[!sideToMove]);
+}
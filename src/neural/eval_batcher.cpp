@@ -0,0 +1,138 @@
+#include "../../include/neural/eval_batcher.hpp"
+#include <algorithm>
+
+EvalBatcher::EvalBatcher(std::shared_ptr<const NetworkWeights> weights, int maxBatch,
+                         std::chrono::microseconds maxWait)
+    : network(std::move(weights))
+    , maxBatch(std::max(1, maxBatch))
+    , maxWait(maxWait)
+    , cacheSalt(network.getWeights()->getCacheSalt())
+    , worker(&EvalBatcher::run, this)
+{
+}
+
+EvalBatcher::~EvalBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    requestReady.notify_one();
+    worker.join();
+}
+
+void EvalBatcher::setWeights(std::shared_ptr<const NetworkWeights> weights) {
+    std::lock_guard<std::mutex> lock(mutex);
+    cacheSalt.store(weights->getCacheSalt(), std::memory_order_relaxed);
+    nextWeights = std::move(weights);
+}
+
+void EvalBatcher::setClients(int newClients) {
+    std::lock_guard<std::mutex> lock(mutex);
+    clients = std::max(1, newClients);
+}
+
+float EvalBatcher::evaluate(uint64_t key, const std::array<uint64_t, 12>& pieces, int sideToMove) {
+    float value;
+    if (NeuralNetwork::probeCache(key, cacheSalt.load(std::memory_order_relaxed), value)) {
+        return value;
+    }
+    
+    Request request{{pieces, sideToMove}};
+    submit(&request, 1);
+    NeuralNetwork::storeCache(key, request.salt, request.result);
+    return request.result;
+}
+
+float EvalBatcher::evaluate(const std::array<uint64_t, 12>& pieces, int sideToMove,
+                            const std::vector<uint16_t>& moves, std::vector<float>& logits) {
+    // The logits are written by the service thread while this one waits.
+    Request request{{pieces, sideToMove, &moves, &logits}};
+    submit(&request, 1);
+    return request.result;
+}
+
+void EvalBatcher::evaluate(const std::vector<uint64_t>& keys, const std::vector<NeuralNetwork::BatchEntry>& inputs,
+                           std::vector<float>& values) {
+    values.resize(inputs.size());
+    const uint64_t salt = cacheSalt.load(std::memory_order_relaxed);
+    std::vector<Request> requests;
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (!NeuralNetwork::probeCache(keys[i], salt, values[i])) {
+            requests.push_back({inputs[i]});
+            slots.push_back(i);
+        }
+    }
+    if (requests.empty()) return;
+
+    submit(requests.data(), requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        values[slots[i]] = requests[i].result;
+        NeuralNetwork::storeCache(keys[slots[i]], requests[i].salt, requests[i].result);
+    }
+}
+
+void EvalBatcher::submit(Request* requests, size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    int outstanding = static_cast<int>(count);
+    const bool wasEmpty = pending.empty();
+    for (size_t i = 0; i < count; ++i) {
+        requests[i].outstanding = &outstanding;
+        pending.push_back(&requests[i]);
+    }
+    ++waiting;
+    if (wasEmpty || batchFull()) {
+        requestReady.notify_one();
+    }
+    resultReady.wait(lock, [&] { return outstanding == 0; });
+}
+
+EvalBatcher::Stats EvalBatcher::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+bool EvalBatcher::batchFull() const {
+    return pending.size() >= static_cast<size_t>(maxBatch) || waiting >= clients;
+}
+
+void EvalBatcher::run() {
+    std::vector<Request*> batch;
+    std::vector<NeuralNetwork::BatchEntry> inputs;
+    std::vector<float> outputs;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        requestReady.wait(lock, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) return;
+
+        requestReady.wait_for(lock, maxWait, [&] { return stopping || batchFull(); });
+
+        const size_t count = std::min(pending.size(), static_cast<size_t>(maxBatch));
+        batch.assign(pending.begin(), pending.begin() + count);
+        pending.erase(pending.begin(), pending.begin() + count);
+        if (nextWeights) {
+            network.setWeights(std::move(nextWeights));
+            nextWeights = nullptr;
+        }
+        lock.unlock();
+
+        inputs.clear();
+        for (const Request* request : batch) {
+            inputs.push_back(request->input);
+        }
+        network.forwardBatch(inputs, outputs);
+
+        lock.lock();
+        for (size_t i = 0; i < count; ++i) {
+            batch[i]->result = outputs[i];
+            batch[i]->salt = network.getWeights()->getCacheSalt();
+            if (--*batch[i]->outstanding == 0) {
+                --waiting;
+            }
+        }
+        ++stats.batches;
+        stats.positions += count;
+        resultReady.notify_all();
+    }
+}
@@ -0,0 +1,161 @@
+#include "../../include/neural/simd_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+// Compiled with -mavx2 -mfma.
+namespace {
+    void axpy(float* y, const float* x, float a, int n) {
+        const __m256 scale = _mm256_set1_ps(a);
+        for (int i = 0; i < n; i += 8) {
+            __m256 acc = _mm256_loadu_ps(y + i);
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), scale, acc);
+            _mm256_storeu_ps(y + i, acc);
+        }
+    }
+
+    void biasReLU(float* out, const float* in, const float* bias, int n) {
+        const __m256 zero = _mm256_setzero_ps();
+        for (int i = 0; i < n; i += 8) {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(in + i), _mm256_loadu_ps(bias + i));
+            _mm256_storeu_ps(out + i, _mm256_max_ps(sum, zero));
+        }
+    }
+
+    void addRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; i += 16) {
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulator + i));
+            __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(accumulator + i), _mm256_add_epi16(acc, w));
+        }
+    }
+
+    void subRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; i += 16) {
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulator + i));
+            __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(accumulator + i), _mm256_sub_epi16(acc, w));
+        }
+    }
+
+    void clippedReLU(uint8_t* out, const int16_t* in, int n) {
+        const __m256i ceiling = _mm256_set1_epi16(127);
+        for (int i = 0; i < n; i += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+            __m256i packed = _mm256_packus_epi16(_mm256_min_epi16(a, ceiling), _mm256_min_epi16(b, ceiling));
+            // packus interleaves the 128-bit lanes of a and b; restore the order.
+            packed = _mm256_permute4x64_epi64(packed, 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+        }
+    }
+
+    int32_t dotProduct(const uint8_t* input, const int8_t* weights, int n) {
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < n; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+            __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+        }
+        __m128i lanes = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, 0x4E));
+        lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, 0xB1));
+        return _mm_cvtsi128_si32(lanes);
+    }
+
+    // Rows of c per block: 2 * GEMM_ROWS accumulators plus two rows of b fill the register file.
+    constexpr int GEMM_ROWS = 6;
+
+    // One ROWS x 16 block of c over a kc-deep slice of a and b.
+    template<int ROWS>
+    void gemmBlock(float* c, const float* a, const float* b, int n, int k, int kc) {
+        __m256 acc[ROWS][2];
+        for (int r = 0; r < ROWS; ++r) {
+            acc[r][0] = _mm256_loadu_ps(c + r * n);
+            acc[r][1] = _mm256_loadu_ps(c + r * n + 8);
+        }
+        for (int p = 0; p < kc; ++p) {
+            const __m256 b0 = _mm256_loadu_ps(b + p * n);
+            const __m256 b1 = _mm256_loadu_ps(b + p * n + 8);
+            for (int r = 0; r < ROWS; ++r) {
+                const __m256 x = _mm256_set1_ps(a[r * k + p]);
+                acc[r][0] = _mm256_fmadd_ps(x, b0, acc[r][0]);
+                acc[r][1] = _mm256_fmadd_ps(x, b1, acc[r][1]);
+            }
+        }
+        for (int r = 0; r < ROWS; ++r) {
+            _mm256_storeu_ps(c + r * n, acc[r][0]);
+            _mm256_storeu_ps(c + r * n + 8, acc[r][1]);
+        }
+    }
+
+    // The kc x 16 panel of b stays in L1 while every row block of a passes over it.
+    void gemm(float* c, const float* a, const float* b, int m, int n, int k) {
+        std::fill(c, c + static_cast<size_t>(m) * n, 0.0f);
+        for (int p0 = 0; p0 < k; p0 += Simd::GEMM_KC) {
+            const int kc = std::min(Simd::GEMM_KC, k - p0);
+            for (int col = 0; col < n; col += 16) {
+                int row = 0;
+                for (; row + GEMM_ROWS <= m; row += GEMM_ROWS) {
+                    gemmBlock<GEMM_ROWS>(c + row * n + col, a + row * k + p0, b + p0 * n + col, n, k, kc);
+                }
+                for (; row < m; ++row) {
+                    gemmBlock<1>(c + row * n + col, a + row * k + p0, b + p0 * n + col, n, k, kc);
+                }
+            }
+        }
+    }
+
+    int nonZeroFloats(uint16_t* out, const float* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 8) {
+            const __m256 x = _mm256_loadu_ps(in + i);
+            const uint32_t mask = _mm256_movemask_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+            count = Simd::appendSetBits(out, count, mask, i);
+        }
+        return count;
+    }
+
+    int nonZeroBlocks(uint16_t* out, const uint8_t* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 32) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            const uint32_t mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, _mm256_setzero_si256()))) & 0xFF;
+            count = Simd::appendSetBits(out, count, mask, i / 4);
+        }
+        return count;
+    }
+
+    // Eight accumulators cover 64 outputs; each listed input group is
+    // broadcast and multiplied against that slice of its weight rows.
+    void sparseAffine(int32_t* out, const uint8_t* in, const int8_t* weights,
+                      const uint16_t* blocks, int count, int outputs) {
+        const __m256i ones = _mm256_set1_epi16(1);
+        for (int chunk = 0; chunk < outputs; chunk += 64) {
+            __m256i acc[8];
+            for (int j = 0; j < 8; ++j) {
+                acc[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + chunk + j * 8));
+            }
+            for (int i = 0; i < count; ++i) {
+                int32_t group;
+                std::memcpy(&group, in + blocks[i] * 4, sizeof(group));
+                const __m256i x = _mm256_set1_epi32(group);
+                const int8_t* w = weights + (blocks[i] * outputs + chunk) * 4;
+                for (int j = 0; j < 8; ++j) {
+                    const __m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + j * 32));
+                    acc[j] = _mm256_add_epi32(acc[j], _mm256_madd_epi16(_mm256_maddubs_epi16(x, row), ones));
+                }
+            }
+            for (int j = 0; j < 8; ++j) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + chunk + j * 8), acc[j]);
+            }
+        }
+    }
+}
+
+const Simd::Kernels Simd::AVX2_KERNELS = {
+    Level::AVX2, "avx2",
+    axpy, biasReLU, addRow, subRow, clippedReLU, dotProduct, gemm,
+    nonZeroFloats, nonZeroBlocks, sparseAffine
+};
@@ -0,0 +1,199 @@
+#include "../../include/neural/simd_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+// Compiled with -mavx512f -mavx512bw -mfma. Only dotProductVNNI may use
+// VNNI instructions; everything else must run on plain AVX-512BW hosts.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_VNNI __attribute__((target("avx512vnni")))
+#else
+#define TARGET_VNNI
+#endif
+
+namespace {
+    void axpy(float* y, const float* x, float a, int n) {
+        const __m512 scale = _mm512_set1_ps(a);
+        for (int i = 0; i < n; i += 16) {
+            __m512 acc = _mm512_loadu_ps(y + i);
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), scale, acc);
+            _mm512_storeu_ps(y + i, acc);
+        }
+    }
+
+    void biasReLU(float* out, const float* in, const float* bias, int n) {
+        const __m512 zero = _mm512_setzero_ps();
+        for (int i = 0; i < n; i += 16) {
+            __m512 sum = _mm512_add_ps(_mm512_loadu_ps(in + i), _mm512_loadu_ps(bias + i));
+            _mm512_storeu_ps(out + i, _mm512_max_ps(sum, zero));
+        }
+    }
+
+    void addRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; i += 32) {
+            __m512i acc = _mm512_loadu_si512(accumulator + i);
+            _mm512_storeu_si512(accumulator + i, _mm512_add_epi16(acc, _mm512_loadu_si512(row + i)));
+        }
+    }
+
+    void subRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; i += 32) {
+            __m512i acc = _mm512_loadu_si512(accumulator + i);
+            _mm512_storeu_si512(accumulator + i, _mm512_sub_epi16(acc, _mm512_loadu_si512(row + i)));
+        }
+    }
+
+    void clippedReLU(uint8_t* out, const int16_t* in, int n) {
+        const __m512i ceiling = _mm512_set1_epi16(127);
+        const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+        for (int i = 0; i < n; i += 64) {
+            __m512i a = _mm512_min_epi16(_mm512_loadu_si512(in + i), ceiling);
+            __m512i b = _mm512_min_epi16(_mm512_loadu_si512(in + i + 32), ceiling);
+            __m512i packed = _mm512_permutexvar_epi64(order, _mm512_packus_epi16(a, b));
+            _mm512_storeu_si512(out + i, packed);
+        }
+    }
+
+    int32_t dotProduct(const uint8_t* input, const int8_t* weights, int n) {
+        const __m512i ones = _mm512_set1_epi16(1);
+        __m512i sum = _mm512_setzero_si512();
+        for (int i = 0; i < n; i += 64) {
+            __m512i x = _mm512_loadu_si512(input + i);
+            __m512i w = _mm512_loadu_si512(weights + i);
+            sum = _mm512_add_epi32(sum, _mm512_madd_epi16(_mm512_maddubs_epi16(x, w), ones));
+        }
+        return _mm512_reduce_add_epi32(sum);
+    }
+
+    TARGET_VNNI int32_t dotProductVNNI(const uint8_t* input, const int8_t* weights, int n) {
+        __m512i sum = _mm512_setzero_si512();
+        for (int i = 0; i < n; i += 64) {
+            sum = _mm512_dpbusd_epi32(sum, _mm512_loadu_si512(input + i), _mm512_loadu_si512(weights + i));
+        }
+        return _mm512_reduce_add_epi32(sum);
+    }
+
+    // Rows of c per block: 2 * GEMM_ROWS accumulators plus two rows of b fill the register file.
+    constexpr int GEMM_ROWS = 8;
+
+    // One ROWS x 32 block of c over a kc-deep slice of a and b.
+    template<int ROWS>
+    void gemmBlock(float* c, const float* a, const float* b, int n, int k, int kc) {
+        __m512 acc[ROWS][2];
+        for (int r = 0; r < ROWS; ++r) {
+            acc[r][0] = _mm512_loadu_ps(c + r * n);
+            acc[r][1] = _mm512_loadu_ps(c + r * n + 16);
+        }
+        for (int p = 0; p < kc; ++p) {
+            const __m512 b0 = _mm512_loadu_ps(b + p * n);
+            const __m512 b1 = _mm512_loadu_ps(b + p * n + 16);
+            for (int r = 0; r < ROWS; ++r) {
+                const __m512 x = _mm512_set1_ps(a[r * k + p]);
+                acc[r][0] = _mm512_fmadd_ps(x, b0, acc[r][0]);
+                acc[r][1] = _mm512_fmadd_ps(x, b1, acc[r][1]);
+            }
+        }
+        for (int r = 0; r < ROWS; ++r) {
+            _mm512_storeu_ps(c + r * n, acc[r][0]);
+            _mm512_storeu_ps(c + r * n + 16, acc[r][1]);
+        }
+    }
+
+    // The kc x 32 panel of b stays in L1 while every row block of a passes over it.
+    void gemm(float* c, const float* a, const float* b, int m, int n, int k) {
+        std::fill(c, c + static_cast<size_t>(m) * n, 0.0f);
+        for (int p0 = 0; p0 < k; p0 += Simd::GEMM_KC) {
+            const int kc = std::min(Simd::GEMM_KC, k - p0);
+            for (int col = 0; col < n; col += 32) {
+                int row = 0;
+                for (; row + GEMM_ROWS <= m; row += GEMM_ROWS) {
+                    gemmBlock<GEMM_ROWS>(c + row * n + col, a + row * k + p0, b + p0 * n + col, n, k, kc);
+                }
+                for (; row < m; ++row) {
+                    gemmBlock<1>(c + row * n + col, a + row * k + p0, b + p0 * n + col, n, k, kc);
+                }
+            }
+        }
+    }
+
+    int nonZeroFloats(uint16_t* out, const float* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 16) {
+            const __m512 x = _mm512_loadu_ps(in + i);
+            const uint32_t mask = _mm512_cmpneq_ps_mask(x, _mm512_setzero_ps());
+            count = Simd::appendSetBits(out, count, mask, i);
+        }
+        return count;
+    }
+
+    int nonZeroBlocks(uint16_t* out, const uint8_t* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 64) {
+            const __m512i x = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(in + i));
+            const uint32_t mask = _mm512_test_epi32_mask(x, x);
+            count = Simd::appendSetBits(out, count, mask, i / 4);
+        }
+        return count;
+    }
+
+    // Eight accumulators cover 128 outputs; each listed input group is
+    // broadcast and multiplied against that slice of its weight rows.
+    void sparseAffine(int32_t* out, const uint8_t* in, const int8_t* weights,
+                      const uint16_t* blocks, int count, int outputs) {
+        const __m512i ones = _mm512_set1_epi16(1);
+        for (int chunk = 0; chunk < outputs; chunk += 128) {
+            __m512i acc[8];
+            for (int j = 0; j < 8; ++j) {
+                acc[j] = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(out + chunk + j * 16));
+            }
+            for (int i = 0; i < count; ++i) {
+                int32_t group;
+                std::memcpy(&group, in + blocks[i] * 4, sizeof(group));
+                const __m512i x = _mm512_set1_epi32(group);
+                const int8_t* w = weights + (blocks[i] * outputs + chunk) * 4;
+                for (int j = 0; j < 8; ++j) {
+                    const __m512i row = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(w + j * 64));
+                    acc[j] = _mm512_add_epi32(acc[j], _mm512_madd_epi16(_mm512_maddubs_epi16(x, row), ones));
+                }
+            }
+            for (int j = 0; j < 8; ++j) {
+                _mm512_storeu_si512(reinterpret_cast<__m512i*>(out + chunk + j * 16), acc[j]);
+            }
+        }
+    }
+
+    TARGET_VNNI void sparseAffineVNNI(int32_t* out, const uint8_t* in, const int8_t* weights,
+                                          const uint16_t* blocks, int count, int outputs) {
+        for (int chunk = 0; chunk < outputs; chunk += 128) {
+            __m512i acc[8];
+            for (int j = 0; j < 8; ++j) {
+                acc[j] = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(out + chunk + j * 16));
+            }
+            for (int i = 0; i < count; ++i) {
+                int32_t group;
+                std::memcpy(&group, in + blocks[i] * 4, sizeof(group));
+                const __m512i x = _mm512_set1_epi32(group);
+                const int8_t* w = weights + (blocks[i] * outputs + chunk) * 4;
+                for (int j = 0; j < 8; ++j) {
+                    const __m512i row = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(w + j * 64));
+                    acc[j] = _mm512_dpbusd_epi32(acc[j], x, row);
+                }
+            }
+            for (int j = 0; j < 8; ++j) {
+                _mm512_storeu_si512(reinterpret_cast<__m512i*>(out + chunk + j * 16), acc[j]);
+            }
+        }
+    }
+}
+
+const Simd::Kernels Simd::AVX512_KERNELS = {
+    Level::AVX512, "avx512",
+    axpy, biasReLU, addRow, subRow, clippedReLU, dotProduct, gemm,
+    nonZeroFloats, nonZeroBlocks, sparseAffine
+};
+
+const Simd::Kernels Simd::AVX512_VNNI_KERNELS = {
+    Level::AVX512_VNNI, "avx512-vnni",
+    axpy, biasReLU, addRow, subRow, clippedReLU, dotProductVNNI, gemm,
+    nonZeroFloats, nonZeroBlocks, sparseAffineVNNI
+};
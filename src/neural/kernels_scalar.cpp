@@ -0,0 +1,76 @@
+#include "../../include/neural/simd_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    void axpy(float* y, const float* x, float a, int n) {
+        for (int i = 0; i < n; ++i) y[i] += a * x[i];
+    }
+
+    void biasReLU(float* out, const float* in, const float* bias, int n) {
+        for (int i = 0; i < n; ++i) out[i] = std::max(in[i] + bias[i], 0.0f);
+    }
+
+    void addRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; ++i) accumulator[i] = static_cast<int16_t>(accumulator[i] + row[i]);
+    }
+
+    void subRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; ++i) accumulator[i] = static_cast<int16_t>(accumulator[i] - row[i]);
+    }
+
+    void clippedReLU(uint8_t* out, const int16_t* in, int n) {
+        for (int i = 0; i < n; ++i) out[i] = static_cast<uint8_t>(std::clamp<int>(in[i], 0, 127));
+    }
+
+    int32_t dotProduct(const uint8_t* input, const int8_t* weights, int n) {
+        int32_t sum = 0;
+        for (int i = 0; i < n; ++i) sum += static_cast<int32_t>(input[i]) * weights[i];
+        return sum;
+    }
+
+    void gemm(float* c, const float* a, const float* b, int m, int n, int k) {
+        std::fill(c, c + static_cast<size_t>(m) * n, 0.0f);
+        for (int row = 0; row < m; ++row) {
+            for (int p = 0; p < k; ++p) {
+                const float x = a[row * k + p];
+                for (int col = 0; col < n; ++col) c[row * n + col] += x * b[p * n + col];
+            }
+        }
+    }
+
+    int nonZeroFloats(uint16_t* out, const float* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (in[i] != 0.0f) out[count++] = static_cast<uint16_t>(i);
+        }
+        return count;
+    }
+
+    int nonZeroBlocks(uint16_t* out, const uint8_t* in, int n) {
+        int count = 0;
+        for (int b = 0; b < n / 4; ++b) {
+            uint32_t block;
+            std::memcpy(&block, in + b * 4, sizeof(block));
+            if (block) out[count++] = static_cast<uint16_t>(b);
+        }
+        return count;
+    }
+
+    void sparseAffine(int32_t* out, const uint8_t* in, const int8_t* weights,
+                      const uint16_t* blocks, int count, int outputs) {
+        for (int i = 0; i < count; ++i) {
+            const uint8_t* x = in + blocks[i] * 4;
+            const int8_t* w = weights + blocks[i] * outputs * 4;
+            for (int j = 0; j < outputs; ++j) {
+                out[j] += x[0] * w[j * 4] + x[1] * w[j * 4 + 1] + x[2] * w[j * 4 + 2] + x[3] * w[j * 4 + 3];
+            }
+        }
+    }
+}
+
+const Simd::Kernels Simd::SCALAR_KERNELS = {
+    Level::SCALAR, "scalar",
+    axpy, biasReLU, addRow, subRow, clippedReLU, dotProduct, gemm,
+    nonZeroFloats, nonZeroBlocks, sparseAffine
+};
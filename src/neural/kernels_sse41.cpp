@@ -0,0 +1,158 @@
+#include "../../include/neural/simd_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+// Compiled with -msse4.1.
+namespace {
+    void axpy(float* y, const float* x, float a, int n) {
+        const __m128 scale = _mm_set1_ps(a);
+        for (int i = 0; i < n; i += 4) {
+            __m128 acc = _mm_loadu_ps(y + i);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + i), scale));
+            _mm_storeu_ps(y + i, acc);
+        }
+    }
+
+    void biasReLU(float* out, const float* in, const float* bias, int n) {
+        const __m128 zero = _mm_setzero_ps();
+        for (int i = 0; i < n; i += 4) {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(in + i), _mm_loadu_ps(bias + i));
+            _mm_storeu_ps(out + i, _mm_max_ps(sum, zero));
+        }
+    }
+
+    void addRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; i += 8) {
+            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i));
+            __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i), _mm_add_epi16(acc, w));
+        }
+    }
+
+    void subRow(int16_t* accumulator, const int16_t* row, int n) {
+        for (int i = 0; i < n; i += 8) {
+            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i));
+            __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i), _mm_sub_epi16(acc, w));
+        }
+    }
+
+    void clippedReLU(uint8_t* out, const int16_t* in, int n) {
+        const __m128i ceiling = _mm_set1_epi16(127);
+        for (int i = 0; i < n; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+            __m128i packed = _mm_packus_epi16(_mm_min_epi16(a, ceiling), _mm_min_epi16(b, ceiling));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+        }
+    }
+
+    int32_t dotProduct(const uint8_t* input, const int8_t* weights, int n) {
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < n; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    // Rows of c per block: 2 * GEMM_ROWS accumulators plus two rows of b fill the register file.
+    constexpr int GEMM_ROWS = 6;
+
+    // One ROWS x 8 block of c over a kc-deep slice of a and b.
+    template<int ROWS>
+    void gemmBlock(float* c, const float* a, const float* b, int n, int k, int kc) {
+        __m128 acc[ROWS][2];
+        for (int r = 0; r < ROWS; ++r) {
+            acc[r][0] = _mm_loadu_ps(c + r * n);
+            acc[r][1] = _mm_loadu_ps(c + r * n + 4);
+        }
+        for (int p = 0; p < kc; ++p) {
+            const __m128 b0 = _mm_loadu_ps(b + p * n);
+            const __m128 b1 = _mm_loadu_ps(b + p * n + 4);
+            for (int r = 0; r < ROWS; ++r) {
+                const __m128 x = _mm_set1_ps(a[r * k + p]);
+                acc[r][0] = _mm_add_ps(acc[r][0], _mm_mul_ps(x, b0));
+                acc[r][1] = _mm_add_ps(acc[r][1], _mm_mul_ps(x, b1));
+            }
+        }
+        for (int r = 0; r < ROWS; ++r) {
+            _mm_storeu_ps(c + r * n, acc[r][0]);
+            _mm_storeu_ps(c + r * n + 4, acc[r][1]);
+        }
+    }
+
+    // The kc x 8 panel of b stays in L1 while every row block of a passes over it.
+    void gemm(float* c, const float* a, const float* b, int m, int n, int k) {
+        std::fill(c, c + static_cast<size_t>(m) * n, 0.0f);
+        for (int p0 = 0; p0 < k; p0 += Simd::GEMM_KC) {
+            const int kc = std::min(Simd::GEMM_KC, k - p0);
+            for (int col = 0; col < n; col += 8) {
+                int row = 0;
+                for (; row + GEMM_ROWS <= m; row += GEMM_ROWS) {
+                    gemmBlock<GEMM_ROWS>(c + row * n + col, a + row * k + p0, b + p0 * n + col, n, k, kc);
+                }
+                for (; row < m; ++row) {
+                    gemmBlock<1>(c + row * n + col, a + row * k + p0, b + p0 * n + col, n, k, kc);
+                }
+            }
+        }
+    }
+
+    int nonZeroFloats(uint16_t* out, const float* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 4) {
+            const __m128 x = _mm_loadu_ps(in + i);
+            const uint32_t mask = _mm_movemask_ps(_mm_cmpneq_ps(x, _mm_setzero_ps()));
+            count = Simd::appendSetBits(out, count, mask, i);
+        }
+        return count;
+    }
+
+    int nonZeroBlocks(uint16_t* out, const uint8_t* in, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            const uint32_t mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, _mm_setzero_si128()))) & 0xF;
+            count = Simd::appendSetBits(out, count, mask, i / 4);
+        }
+        return count;
+    }
+
+    // Eight accumulators cover 32 outputs; each listed input group is
+    // broadcast and multiplied against that slice of its weight rows.
+    void sparseAffine(int32_t* out, const uint8_t* in, const int8_t* weights,
+                      const uint16_t* blocks, int count, int outputs) {
+        const __m128i ones = _mm_set1_epi16(1);
+        for (int chunk = 0; chunk < outputs; chunk += 32) {
+            __m128i acc[8];
+            for (int j = 0; j < 8; ++j) {
+                acc[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + chunk + j * 4));
+            }
+            for (int i = 0; i < count; ++i) {
+                int32_t group;
+                std::memcpy(&group, in + blocks[i] * 4, sizeof(group));
+                const __m128i x = _mm_set1_epi32(group);
+                const int8_t* w = weights + (blocks[i] * outputs + chunk) * 4;
+                for (int j = 0; j < 8; ++j) {
+                    const __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + j * 16));
+                    acc[j] = _mm_add_epi32(acc[j], _mm_madd_epi16(_mm_maddubs_epi16(x, row), ones));
+                }
+            }
+            for (int j = 0; j < 8; ++j) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + chunk + j * 4), acc[j]);
+            }
+        }
+    }
+}
+
+const Simd::Kernels Simd::SSE41_KERNELS = {
+    Level::SSE41, "sse4.1",
+    axpy, biasReLU, addRow, subRow, clippedReLU, dotProduct, gemm,
+    nonZeroFloats, nonZeroBlocks, sparseAffine
+};
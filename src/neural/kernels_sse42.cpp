@@ -0,0 +1,24 @@
+#include "../../include/neural/simd_kernels.hpp"
+#include <cstring>
+#include <nmmintrin.h>
+
+// Compiled with -msse4.2.
+uint32_t Simd::crc32Words(const void* data, size_t words, uint32_t crc) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t wide = crc;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+    }
+    return static_cast<uint32_t>(wide);
+#else
+    for (size_t i = 0; i < words * 2; ++i) {
+        uint32_t word;
+        std::memcpy(&word, bytes + i * 4, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+    }
+    return crc;
+#endif
+}
@@ -0,0 +1,133 @@
+#include "../../include/neural/large_pages.hpp"
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+    constexpr size_t CACHE_LINE = 64;
+
+    size_t roundUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+#ifdef _WIN32
+    // MEM_LARGE_PAGES fails unless the process has enabled this privilege.
+    bool enableLockMemoryPrivilege() {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            return false;
+        }
+
+        TOKEN_PRIVILEGES privileges{};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool granted = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+                       AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+                       GetLastError() == ERROR_SUCCESS;
+        CloseHandle(token);
+        return granted;
+    }
+
+    void* allocateLarge(size_t& bytes) {
+        static const bool privileged = enableLockMemoryPrivilege();
+        const size_t pageSize = GetLargePageMinimum();
+        if (!privileged || pageSize == 0) return nullptr;
+
+        bytes = roundUp(bytes, pageSize);
+        return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    }
+#else
+    void* allocateLarge(size_t& bytes) {
+#if defined(MADV_HUGEPAGE)
+        const size_t rounded = roundUp(bytes, LargePageBuffer::LARGE_PAGE_SIZE);
+        void* memory = std::aligned_alloc(LargePageBuffer::LARGE_PAGE_SIZE, rounded);
+        if (!memory) return nullptr;
+
+        // Only a hint: the kernel may still back the range with 4 KB pages
+        // when THP is disabled or memory is fragmented.
+        if (madvise(memory, rounded, MADV_HUGEPAGE) != 0) {
+            std::free(memory);
+            return nullptr;
+        }
+        bytes = rounded;
+        return memory;
+#else
+        (void)bytes;
+        return nullptr;
+#endif
+    }
+#endif
+
+    void* allocateAligned(size_t bytes) {
+#ifdef _WIN32
+        return _aligned_malloc(bytes, CACHE_LINE);
+#else
+        return std::aligned_alloc(CACHE_LINE, roundUp(bytes, CACHE_LINE));
+#endif
+    }
+}
+
+LargePageBuffer::LargePageBuffer(size_t bytes)
+    : length(bytes)
+{
+    if (bytes == 0) return;
+
+    if (bytes >= LARGE_PAGE_SIZE && enabled.load(std::memory_order_relaxed)) {
+        size_t rounded = bytes;
+        base = allocateLarge(rounded);
+        large = base != nullptr;
+    }
+    if (!base) {
+        base = allocateAligned(bytes);
+    }
+    if (!base) {
+        throw std::bad_alloc();
+    }
+}
+
+LargePageBuffer::~LargePageBuffer() {
+    release();
+}
+
+LargePageBuffer::LargePageBuffer(LargePageBuffer&& other) noexcept
+    : base(std::exchange(other.base, nullptr))
+    , length(std::exchange(other.length, 0))
+    , large(std::exchange(other.large, false))
+{
+}
+
+LargePageBuffer& LargePageBuffer::operator=(LargePageBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        base = std::exchange(other.base, nullptr);
+        length = std::exchange(other.length, 0);
+        large = std::exchange(other.large, false);
+    }
+    return *this;
+}
+
+void LargePageBuffer::setEnabled(bool value) {
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+void LargePageBuffer::release() {
+    if (!base) return;
+#ifdef _WIN32
+    if (large) {
+        VirtualFree(base, 0, MEM_RELEASE);
+    } else {
+        _aligned_free(base);
+    }
+#else
+    std::free(base);
+#endif
+    base = nullptr;
+}
@@ -0,0 +1,220 @@
+#include "../../include/neural/network_file.hpp"
+#include "../../include/neural/simd_kernels.hpp"
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr std::array<uint32_t, 256> buildCrcTable() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint32_t, 256> CRC_TABLE = buildCrcTable();
+
+    size_t alignUp(size_t value) {
+        const size_t mask = NetworkFile::SECTION_ALIGNMENT - 1;
+        return (value + mask) & ~mask;
+    }
+
+    uint32_t headerCrc(NetworkFile::Header header, const NetworkFile::SectionEntry* entries, size_t count) {
+        header.headerCrc = 0;
+        uint32_t crc = NetworkFile::crc32(&header, sizeof(header));
+        return NetworkFile::crc32(entries, count * sizeof(NetworkFile::SectionEntry), crc);
+    }
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+#else
+    if (base) munmap(const_cast<uint8_t*>(base), length);
+#endif
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path, std::string& error) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    file->fileHandle = handle;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        error = "cannot read size of " + path;
+        return nullptr;
+    }
+    file->length = static_cast<size_t>(size.QuadPart);
+
+    file->mappingHandle = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->mappingHandle) {
+        error = "cannot map " + path;
+        return nullptr;
+    }
+    file->base = static_cast<const uint8_t*>(MapViewOfFile(file->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        error = "cannot read size of " + path;
+        return nullptr;
+    }
+    file->length = static_cast<size_t>(info.st_size);
+
+    void* mapped = mmap(nullptr, file->length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped != MAP_FAILED) {
+        file->base = static_cast<const uint8_t*>(mapped);
+    }
+#endif
+
+    if (!file->base) {
+        error = "cannot map " + path;
+        return nullptr;
+    }
+    return file;
+}
+
+const NetworkFile::Section* NetworkFile::View::find(uint32_t id) const {
+    for (const auto& section : sections) {
+        if (section.id == id) return &section;
+    }
+    return nullptr;
+}
+
+uint32_t NetworkFile::crc32(const void* data, size_t size, uint32_t crc) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    size_t i = 0;
+#if defined(CHESS_SIMD_X86)
+    if (Simd::hasCrc32()) {
+        i = size / 8 * 8;
+        crc = Simd::crc32Words(bytes, size / 8, crc);
+    }
+#endif
+    for (; i < size; ++i) {
+        crc = CRC_TABLE[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool NetworkFile::write(const std::string& path, uint64_t architectureHash, const std::vector<Section>& sections) {
+    std::vector<SectionEntry> entries(sections.size());
+    size_t offset = alignUp(sizeof(Header) + entries.size() * sizeof(SectionEntry));
+
+    for (size_t i = 0; i < sections.size(); ++i) {
+        entries[i] = {sections[i].id, crc32(sections[i].data, sections[i].size), offset, sections[i].size};
+        offset = alignUp(offset + sections[i].size);
+    }
+
+    Header header{MAGIC, VERSION, static_cast<uint32_t>(sections.size()), architectureHash, 0, 0};
+    header.headerCrc = headerCrc(header, entries.data(), entries.size());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size() * sizeof(SectionEntry)));
+
+    static constexpr std::array<char, SECTION_ALIGNMENT> padding{};
+    for (size_t i = 0; i < sections.size(); ++i) {
+        file.write(padding.data(), static_cast<std::streamsize>(entries[i].offset - static_cast<size_t>(file.tellp())));
+        file.write(static_cast<const char*>(sections[i].data), static_cast<std::streamsize>(sections[i].size));
+    }
+    return file.good();
+}
+
+bool NetworkFile::parse(const uint8_t* base, size_t size, const std::string& name, uint64_t architectureHash,
+                        bool verifyChecksums, View& view, std::string& error) {
+    Header header;
+    if (size < sizeof(header)) {
+        error = name + " is truncated";
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+
+    if (header.magic != MAGIC) {
+        error = name + " is not a network file";
+        return false;
+    }
+    if (header.version != VERSION) {
+        error = name + " has format version " + std::to_string(header.version) +
+                ", expected " + std::to_string(VERSION);
+        return false;
+    }
+    if (header.architectureHash != architectureHash) {
+        error = name + " was built for a different network architecture";
+        return false;
+    }
+
+    const size_t tableEnd = sizeof(header) + static_cast<size_t>(header.sectionCount) * sizeof(SectionEntry);
+    if (tableEnd > size) {
+        error = name + " is truncated";
+        return false;
+    }
+
+    std::vector<SectionEntry> entries(header.sectionCount);
+    std::memcpy(entries.data(), base + sizeof(header), entries.size() * sizeof(SectionEntry));
+    if (headerCrc(header, entries.data(), entries.size()) != header.headerCrc) {
+        error = name + " has a corrupt header";
+        return false;
+    }
+
+    View result{nullptr, {}};
+    for (const auto& entry : entries) {
+        if (entry.offset % SECTION_ALIGNMENT != 0 || entry.offset > size || entry.size > size - entry.offset) {
+            error = name + " is truncated or has a misaligned section " + std::to_string(entry.id);
+            return false;
+        }
+        if (verifyChecksums && crc32(base + entry.offset, entry.size) != entry.crc) {
+            error = name + " failed checksum in section " + std::to_string(entry.id);
+            return false;
+        }
+        result.sections.push_back({entry.id, base + entry.offset, entry.size});
+    }
+
+    view = std::move(result);
+    return true;
+}
+
+bool NetworkFile::open(const std::string& path, uint64_t architectureHash, bool verifyChecksums,
+                       View& view, std::string& error) {
+    auto mapping = MappedFile::open(path, error);
+    if (!mapping) return false;
+
+    if (!parse(mapping->data(), mapping->size(), path, architectureHash, verifyChecksums, view, error)) {
+        return false;
+    }
+    view.mapping = std::move(mapping);
+    return true;
+}
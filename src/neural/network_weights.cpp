@@ -0,0 +1,85 @@
+#include "../../include/neural/network_weights.hpp"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <utility>
+
+namespace {
+    std::mutex registryMutex;
+    std::weak_ptr<const NetworkWeights> sharedRandom;
+    std::map<std::pair<std::string, std::filesystem::file_time_type>, std::weak_ptr<const NetworkWeights>> sharedFiles;
+}
+
+NetworkWeights::NetworkWeights(bool withPolicy)
+    : storage((TOTAL_FLOATS + (withPolicy ? POLICY_FLOATS : 0)) * sizeof(float))
+{
+    const float* base = values();
+    inputLayer = {base, base + INPUT_WEIGHTS};
+    base += INPUT_WEIGHTS + HIDDEN_SIZE;
+    hiddenLayer = {base, base + HIDDEN_WEIGHTS};
+    base += HIDDEN_WEIGHTS + HIDDEN_SIZE;
+    outputLayer = {base, base + OUTPUT_WEIGHTS};
+    base += OUTPUT_WEIGHTS + OUTPUT_SIZE;
+    if (withPolicy) {
+        policyLayer = {base, base + POLICY_FLOATS - POLICY_SIZE};
+    }
+
+    std::random_device rd;
+    cacheSalt = (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+std::shared_ptr<const NetworkWeights> NetworkWeights::random() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (auto existing = sharedRandom.lock()) return existing;
+
+    // An untrained policy would only add noise to the priors.
+    std::shared_ptr<NetworkWeights> weights(new NetworkWeights(false));
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    // Layers are contiguous in storage, each as weights then biases.
+    float* value = weights->values();
+    auto initLayer = [&](size_t count, int fanIn) {
+        const float scale = std::sqrt(2.0f / fanIn);
+        for (size_t i = 0; i < count; ++i) *value++ = dist(gen) * scale;
+    };
+    initLayer(INPUT_WEIGHTS + HIDDEN_SIZE, INPUT_SIZE);
+    initLayer(HIDDEN_WEIGHTS + HIDDEN_SIZE, 2 * HIDDEN_SIZE);
+    initLayer(OUTPUT_WEIGHTS + OUTPUT_SIZE, HIDDEN_SIZE);
+
+    sharedRandom = weights;
+    return weights;
+}
+
+std::shared_ptr<const NetworkWeights> NetworkWeights::load(const std::string& path) {
+    std::error_code ec;
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec) return nullptr;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    const auto key = std::make_pair(path, modified);
+    if (auto found = sharedFiles.find(key); found != sharedFiles.end()) {
+        if (auto existing = found->second.lock()) return existing;
+    }
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : -1;
+    const bool withPolicy = size == static_cast<std::streamoff>((TOTAL_FLOATS + POLICY_FLOATS) * sizeof(float));
+    if (!withPolicy && size != static_cast<std::streamoff>(TOTAL_FLOATS * sizeof(float))) {
+        return nullptr;
+    }
+    file.seekg(0);
+
+    std::shared_ptr<NetworkWeights> weights(new NetworkWeights(withPolicy));
+    file.read(reinterpret_cast<char*>(weights->values()), static_cast<std::streamsize>(size));
+    if (!file) return nullptr;
+
+    // Drop entries whose weights are gone so reloads of a changing file don't pile up.
+    std::erase_if(sharedFiles, [](const auto& entry) { return entry.second.expired(); });
+    sharedFiles[key] = weights;
+    return weights;
+}
@@ -1,137 +1,245 @@
 #include "../../include/neural/neural_network.hpp"
-#include <fstream>
-#include <random>
-#include <immintrin.h>
+#include "../../include/neural/simd_kernels.hpp"
 #include <algorithm>
+#include <bit>
 
-NeuralNetwork::NeuralNetwork() : accumulatorValid(false) {
-    inputLayer.weights.resize(INPUT_SIZE * HIDDEN_SIZE);
-    inputLayer.biases.resize(HIDDEN_SIZE);
-    inputLayer.output.resize(HIDDEN_SIZE);
-    
-    hiddenLayer.weights.resize(HIDDEN_SIZE * HIDDEN_SIZE);
-    hiddenLayer.biases.resize(HIDDEN_SIZE);
-    hiddenLayer.output.resize(HIDDEN_SIZE);
-    
-    outputLayer.weights.resize(HIDDEN_SIZE * OUTPUT_SIZE);
-    outputLayer.biases.resize(OUTPUT_SIZE);
-    outputLayer.output.resize(OUTPUT_SIZE);
-    
-    accumulator.resize(HIDDEN_SIZE);
-    initializeWeights();
-}
-
-void NeuralNetwork::loadWeights(const std::string& path) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file) return;
-    
-    file.read(reinterpret_cast<char*>(inputLayer.weights.data()), 
-              INPUT_SIZE * HIDDEN_SIZE * sizeof(float));
-    file.read(reinterpret_cast<char*>(inputLayer.biases.data()),
-              HIDDEN_SIZE * sizeof(float));
-    file.read(reinterpret_cast<char*>(hiddenLayer.weights.data()),
-              HIDDEN_SIZE * HIDDEN_SIZE * sizeof(float));
-    file.read(reinterpret_cast<char*>(hiddenLayer.biases.data()),
-              HIDDEN_SIZE * sizeof(float));
-    file.read(reinterpret_cast<char*>(outputLayer.weights.data()),
-              HIDDEN_SIZE * OUTPUT_SIZE * sizeof(float));
-    file.read(reinterpret_cast<char*>(outputLayer.biases.data()),
-              OUTPUT_SIZE * sizeof(float));
-}
-
-float NeuralNetwork::forward(const std::array<float, INPUT_SIZE>& input) {
-    computeHiddenLayer(input);
-    computeOutputLayer();
-    return outputLayer.output[0];
-}
-
-void NeuralNetwork::updateAccumulator(int piece, int square, bool add) {
-    const float* weights = inputLayer.weights.data() + (piece * 64 + square) * HIDDEN_SIZE;
-    float factor = add ? 1.0f : -1.0f;
-    
-    __m256 factor_vec = _mm256_set1_ps(factor);
-    for (int i = 0; i < HIDDEN_SIZE; i += 8) {
-        __m256 acc = _mm256_load_ps(&accumulator[i]);
-        __m256 w = _mm256_load_ps(&weights[i]);
-        acc = _mm256_fmadd_ps(w, factor_vec, acc);
-        _mm256_store_ps(&accumulator[i], acc);
+#ifdef CHESS_USE_BLAS
+#include <cblas.h>
+#endif
+
+namespace {
+    // c = a * b, row-major; a is m x k, b is k x n.
+    void matMul(float* c, const float* a, const float* b, int m, int n, int k) {
+#ifdef CHESS_USE_BLAS
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m, n, k, 1.0f, a, k, b, n, 0.0f, c, n);
+#else
+        Simd::kernels().gemm(c, a, b, m, n, k);
+#endif
     }
+}
+
+AccumulatorState::AccumulatorState()
+    : transformed(2 * NeuralNetwork::HIDDEN_SIZE)
+    , hidden(NeuralNetwork::HIDDEN_SIZE)
+{
+    accumulators[0].resize(NeuralNetwork::HIDDEN_SIZE);
+    accumulators[1].resize(NeuralNetwork::HIDDEN_SIZE);
+}
+
+NeuralNetwork::NeuralNetwork()
+    : NeuralNetwork(NetworkWeights::random())
+{
+}
+
+NeuralNetwork::NeuralNetwork(std::shared_ptr<const NetworkWeights> weights)
+    : weights(std::move(weights))
+{
+}
+
+bool NeuralNetwork::loadWeights(const std::string& path) {
+    auto loaded = NetworkWeights::load(path);
+    if (!loaded) return false;
     
-    accumulatorValid = true;
+    weights = std::move(loaded);
+    return true;
+}
+
+void NeuralNetwork::setWeights(std::shared_ptr<const NetworkWeights> newWeights) {
+    weights = std::move(newWeights);
+}
+
+float NeuralNetwork::forward(const NetworkWeights& weights, AccumulatorState& state,
+                             const std::array<uint64_t, 12>& pieces, int sideToMove) {
+    computeFeatureTransformer(weights, state, pieces, sideToMove, state.transformed.data());
+    computeHiddenLayer(weights, state);
+    return computeOutputLayer(weights, state);
 }
 
-void NeuralNetwork::resetAccumulator() {
-    std::fill(accumulator.begin(), accumulator.end(), 0.0f);
-    accumulatorValid = false;
+float NeuralNetwork::forward(const NetworkWeights& weights, AccumulatorState& state,
+                             const std::array<uint64_t, 12>& pieces, int sideToMove,
+                             const std::vector<uint16_t>& moves, std::vector<float>& logits) {
+    const float value = forward(weights, state, pieces, sideToMove);
+    computePolicy(weights, state.hidden.data(), sideToMove, moves, logits);
+    return value;
 }
 
-void NeuralNetwork::initializeWeights() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::normal_distribution<float> dist(0.0f, 1.0f);
+void NeuralNetwork::forwardBatch(const std::vector<BatchEntry>& batch, std::vector<float>& outputs) {
+    const Simd::Kernels& simd = Simd::kernels();
+    const int count = static_cast<int>(batch.size());
+    constexpr int hiddenInputs = 2 * HIDDEN_SIZE;
     
-    auto initLayer = [&](Layer& layer, int fanIn) {
-        float scale = std::sqrt(2.0f / fanIn);
-        for (auto& w : layer.weights) w = dist(gen) * scale;
-        for (auto& b : layer.biases) b = dist(gen) * scale;
-    };
+    const NetworkWeights::Layer& hiddenLayer = weights->getHiddenLayer();
+    const NetworkWeights::Layer& outputLayer = weights->getOutputLayer();
+    std::vector<float>& batchInputs = state.batchInputs;
+    std::vector<float>& batchHidden = state.batchHidden;
     
-    initLayer(inputLayer, INPUT_SIZE);
-    initLayer(hiddenLayer, HIDDEN_SIZE);
-    initLayer(outputLayer, HIDDEN_SIZE);
+    batchInputs.resize(static_cast<size_t>(count) * hiddenInputs);
+    batchHidden.resize(static_cast<size_t>(count) * HIDDEN_SIZE);
+    outputs.resize(count);
+    
+    // Below this the sparse per-position path, which skips zero activations, wins.
+    if (count < MIN_GEMM_BATCH) {
+        for (int i = 0; i < count; ++i) {
+            const BatchEntry& entry = batch[i];
+            outputs[i] = entry.moves ? forward(*weights, state, entry.pieces, entry.sideToMove, *entry.moves, *entry.logits)
+                                     : forward(entry.pieces, entry.sideToMove);
+        }
+        return;
+    }
+    
+    // Only ~32 of the INPUT_SIZE features are active, so the feature
+    // transformer stays a per-position sum of weight rows.
+    for (int i = 0; i < count; ++i) {
+        computeFeatureTransformer(*weights, state, batch[i].pieces, batch[i].sideToMove, &batchInputs[i * hiddenInputs]);
+    }
+    
+    matMul(batchHidden.data(), batchInputs.data(), hiddenLayer.weights, count, HIDDEN_SIZE, hiddenInputs);
+    
+    for (int i = 0; i < count; ++i) {
+        float* hidden = &batchHidden[i * HIDDEN_SIZE];
+        simd.biasReLU(hidden, hidden, hiddenLayer.biases, HIDDEN_SIZE);
+        
+        float sum = outputLayer.biases[0];
+        for (int j = 0; j < HIDDEN_SIZE; ++j) {
+            sum += hidden[j] * outputLayer.weights[j];
+        }
+        outputs[i] = activateTanh(sum);
+        
+        if (batch[i].moves) {
+            computePolicy(*weights, hidden, batch[i].sideToMove, *batch[i].moves, *batch[i].logits);
+        }
+    }
 }
 
-float NeuralNetwork::activateReLU(float x) {
-    return std::max(0.0f, x);
+float NeuralNetwork::evaluate(const NetworkWeights& weights, AccumulatorState& state, uint64_t key,
+                              const std::array<uint64_t, 12>& pieces, int sideToMove) {
+    float value;
+    if (probeCache(key, weights.getCacheSalt(), value)) {
+        return value;
+    }
+    
+    value = forward(weights, state, pieces, sideToMove);
+    storeCache(key, weights.getCacheSalt(), value);
+    return value;
+}
+
+bool NeuralNetwork::probeCache(uint64_t key, uint64_t salt, float& value) {
+    auto& cache = threadCache();
+    if (!key || !cache.sizeKB()) return false;
+    
+    // Every thread has its own cache, so the totals are kept here.
+    const bool hit = cache.probe(key ^ salt, value);
+    cacheProbes.fetch_add(1, std::memory_order_relaxed);
+    if (hit) cacheHits.fetch_add(1, std::memory_order_relaxed);
+    return hit;
 }
 
-float NeuralNetwork::activateTanh(float x) {
-    return std::tanh(x);
+void NeuralNetwork::storeCache(uint64_t key, uint64_t salt, float value) {
+    if (key) threadCache().store(key ^ salt, value);
 }
 
-void NeuralNetwork::computeHiddenLayer(const std::array<float, INPUT_SIZE>& input) {
-    if (!accumulatorValid) {
+void NeuralNetwork::setCacheSize(size_t sizeKB) {
+    cacheSizeKB.store(sizeKB, std::memory_order_relaxed);
+    cacheHits.store(0, std::memory_order_relaxed);
+    cacheProbes.store(0, std::memory_order_relaxed);
+}
+
+EvalCache<float>::Stats NeuralNetwork::getCacheStats() {
+    return {cacheHits.load(std::memory_order_relaxed), cacheProbes.load(std::memory_order_relaxed)};
+}
+
+EvalCache<float>& NeuralNetwork::threadCache() {
+    thread_local EvalCache<float> cache(0);
+    
+    size_t sizeKB = cacheSizeKB.load(std::memory_order_relaxed);
+    if (cache.sizeKB() != sizeKB) {
+        cache.resize(sizeKB);
+    }
+    return cache;
+}
+
+void NeuralNetwork::computeFeatureTransformer(const NetworkWeights& weights, AccumulatorState& state,
+                                              const std::array<uint64_t, 12>& pieces, int sideToMove, float* output) {
+    const Simd::Kernels& simd = Simd::kernels();
+    const NetworkWeights::Layer& inputLayer = weights.getInputLayer();
+    
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        std::vector<float>& accumulator = state.accumulators[perspective];
+        const int kingSquare = HalfKA::kingSquare(pieces, perspective);
         std::fill(accumulator.begin(), accumulator.end(), 0.0f);
         
-        for (int i = 0; i < INPUT_SIZE; ++i) {
-            if (input[i] == 0.0f) continue;
-            
-            const float* weights = &inputLayer.weights[i * HIDDEN_SIZE];
-            __m256 input_vec = _mm256_set1_ps(input[i]);
-            
-            for (int j = 0; j < HIDDEN_SIZE; j += 8) {
-                __m256 acc = _mm256_load_ps(&accumulator[j]);
-                __m256 w = _mm256_load_ps(&weights[j]);
-                acc = _mm256_fmadd_ps(w, input_vec, acc);
-                _mm256_store_ps(&accumulator[j], acc);
+        for (int piece = 0; piece < 12; ++piece) {
+            uint64_t bb = pieces[piece];
+            while (bb) {
+                const int feature = HalfKA::index(perspective, kingSquare, piece, std::countr_zero(bb));
+                simd.axpy(accumulator.data(), &inputLayer.weights[feature * HIDDEN_SIZE], 1.0f, HIDDEN_SIZE);
+                bb &= bb - 1;
             }
         }
+        
+        const int half = perspective == sideToMove ? 0 : HIDDEN_SIZE;
+        simd.biasReLU(output + half, accumulator.data(), inputLayer.biases, HIDDEN_SIZE);
     }
+}
+
+void NeuralNetwork::computeHiddenLayer(const NetworkWeights& weights, AccumulatorState& state) {
+    const Simd::Kernels& simd = Simd::kernels();
+    const NetworkWeights::Layer& hiddenLayer = weights.getHiddenLayer();
+    std::vector<float>& output = state.hidden;
     
-    for (int i = 0; i < HIDDEN_SIZE; i += 8) {
-        __m256 acc = _mm256_load_ps(&accumulator[i]);
-        __m256 bias = _mm256_load_ps(&inputLayer.biases[i]);
-        __m256 sum = _mm256_add_ps(acc, bias);
-        __m256 activated = _mm256_max_ps(_mm256_setzero_ps(), sum);
-        _mm256_store_ps(&inputLayer.output[i], activated);
+    std::fill(output.begin(), output.end(), 0.0f);
+    
+    // Weights are input-major, so each non-zero input is one contiguous row.
+    alignas(64) std::array<uint16_t, 2 * HIDDEN_SIZE> nonZero;
+    const int count = simd.nonZeroFloats(nonZero.data(), state.transformed.data(), 2 * HIDDEN_SIZE);
+    for (int i = 0; i < count; ++i) {
+        const int input = nonZero[i];
+        simd.axpy(output.data(), &hiddenLayer.weights[input * HIDDEN_SIZE], state.transformed[input], HIDDEN_SIZE);
     }
+    
+    simd.biasReLU(output.data(), output.data(), hiddenLayer.biases, HIDDEN_SIZE);
 }
 
-void NeuralNetwork::computeOutputLayer() {
-    std::fill(outputLayer.output.begin(), outputLayer.output.end(), 0.0f);
+float NeuralNetwork::computeOutputLayer(const NetworkWeights& weights, const AccumulatorState& state) {
+    const NetworkWeights::Layer& outputLayer = weights.getOutputLayer();
+    std::array<float, OUTPUT_SIZE> output{};
     
-    for (int i = 0; i < HIDDEN_SIZE; ++i) {
-        if (inputLayer.output[i] == 0.0f) continue;
-        
-        const float* weights = &outputLayer.weights[i * OUTPUT_SIZE];
-        float input_val = inputLayer.output[i];
+    alignas(64) std::array<uint16_t, HIDDEN_SIZE> nonZero;
+    const int count = Simd::kernels().nonZeroFloats(nonZero.data(), state.hidden.data(), HIDDEN_SIZE);
+    for (int i = 0; i < count; ++i) {
+        const float* row = &outputLayer.weights[nonZero[i] * OUTPUT_SIZE];
+        float input_val = state.hidden[nonZero[i]];
         
         for (int j = 0; j < OUTPUT_SIZE; ++j) {
-            outputLayer.output[j] += input_val * weights[j];
+            output[j] += input_val * row[j];
         }
     }
     
     for (int i = 0; i < OUTPUT_SIZE; ++i) {
-        outputLayer.output[i] = activateTanh(outputLayer.output[i] + outputLayer.biases[i]);
+        output[i] = activateTanh(output[i] + outputLayer.biases[i]);
+    }
+    return output[0];
+}
+
+void NeuralNetwork::computePolicy(const NetworkWeights& weights, const float* hidden, int sideToMove,
+                                  const std::vector<uint16_t>& moves, std::vector<float>& logits) {
+    logits.assign(moves.size(), 0.0f);
+    if (!weights.hasPolicy()) return;
+    
+    // Only the rows of the legal moves are needed, each a contiguous dot
+    // product, instead of all POLICY_SIZE outputs.
+    const NetworkWeights::Layer& policyLayer = weights.getPolicyLayer();
+    const int flip = HalfKA::flip(sideToMove);
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const int from = (moves[i] & 0x3F) ^ flip;
+        const int to = ((moves[i] >> 6) & 0x3F) ^ flip;
+        const int output = from + 64 * to;
+        const float* row = &policyLayer.weights[static_cast<size_t>(output) * HIDDEN_SIZE];
+        
+        float sum = policyLayer.biases[output];
+        for (int j = 0; j < HIDDEN_SIZE; ++j) {
+            sum += hidden[j] * row[j];
+        }
+        logits[i] = sum;
     }
 }
@@ -0,0 +1,186 @@
+#include "../../include/neural/quantized_network.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include "../../include/neural/embedded_network.hpp"
+#include "../../include/neural/simd_kernels.hpp"
+
+namespace {
+    template<typename T>
+    T quantizeValue(float value, float scale, int limit) {
+        long rounded = std::lround(value * scale);
+        return static_cast<T>(std::clamp<long>(rounded, -limit, limit));
+    }
+}
+
+QuantizedNetwork::QuantizedNetwork()
+    : ftWeights(INPUT_SIZE * FT_SIZE)
+    , ftBiases(FT_SIZE)
+    , l2Weights(L2_SIZE * L2_INPUT_SIZE)
+    , l2Biases(L2_SIZE)
+    , outputWeights(L2_SIZE)
+    , outputBias(1)
+{
+}
+
+void QuantizedNetwork::quantize(const NetworkWeights& source) {
+    constexpr float denseBiasScale = static_cast<float>(FT_SCALE * WEIGHT_SCALE);
+
+    int16_t* ftWeightValues = ftWeights.allocate();
+    for (size_t i = 0; i < ftWeights.count; ++i) {
+        ftWeightValues[i] = quantizeValue<int16_t>(source.getInputLayer().weights[i], FT_SCALE, 32767);
+    }
+    int16_t* ftBiasValues = ftBiases.allocate();
+    for (int i = 0; i < FT_SIZE; ++i) {
+        ftBiasValues[i] = quantizeValue<int16_t>(source.getInputLayer().biases[i], FT_SCALE, 32767);
+    }
+
+    // Blocked so that each group of four inputs owns one contiguous run of
+    // weights covering every output, which is all sparseAffine reads for it.
+    int8_t* l2WeightValues = l2Weights.allocate();
+    int32_t* l2BiasValues = l2Biases.allocate();
+    for (int out = 0; out < L2_SIZE; ++out) {
+        for (int in = 0; in < L2_INPUT_SIZE; ++in) {
+            l2WeightValues[((in / 4) * L2_SIZE + out) * 4 + in % 4] =
+                quantizeValue<int8_t>(source.getHiddenLayer().weights[in * L2_SIZE + out], WEIGHT_SCALE, 127);
+        }
+        l2BiasValues[out] = quantizeValue<int32_t>(source.getHiddenLayer().biases[out], denseBiasScale, 1 << 30);
+    }
+
+    int8_t* outputWeightValues = outputWeights.allocate();
+    for (int in = 0; in < L2_SIZE; ++in) {
+        outputWeightValues[in] = quantizeValue<int8_t>(source.getOutputLayer().weights[in], WEIGHT_SCALE, 127);
+    }
+    outputBias.allocate()[0] = quantizeValue<int32_t>(source.getOutputLayer().biases[0], denseBiasScale, 1 << 30);
+
+    mapping.reset();
+}
+
+bool QuantizedNetwork::loadWeights(const std::string& path, std::string& error, bool verifyChecksums) {
+    NetworkFile::View view;
+    return NetworkFile::open(path, architectureHash(), verifyChecksums, view, error) &&
+           useSections(view, path, error);
+}
+
+bool QuantizedNetwork::loadEmbedded(std::string& error, bool verifyChecksums) {
+    if (!EmbeddedNetwork::data()) {
+        error = "no network was embedded in this build";
+        return false;
+    }
+    NetworkFile::View view;
+    return NetworkFile::parse(EmbeddedNetwork::data(), EmbeddedNetwork::size(), EmbeddedNetwork::NAME,
+                              architectureHash(), verifyChecksums, view, error) &&
+           useSections(view, EmbeddedNetwork::NAME, error);
+}
+
+bool QuantizedNetwork::useSections(const NetworkFile::View& view, const std::string& name, std::string& error) {
+    auto section = [&](uint32_t id, size_t bytes) -> const void* {
+        const NetworkFile::Section* found = view.find(id);
+        if (!found || found->size != bytes) {
+            error = name + " is missing section " + std::to_string(id) + " or it has the wrong size";
+            return nullptr;
+        }
+        return found->data;
+    };
+
+    const void* ftWeightData = section(FT_WEIGHTS, ftWeights.bytes());
+    const void* ftBiasData = section(FT_BIASES, ftBiases.bytes());
+    const void* l2WeightData = section(L2_WEIGHTS, l2Weights.bytes());
+    const void* l2BiasData = section(L2_BIASES, l2Biases.bytes());
+    const void* outputWeightData = section(OUTPUT_WEIGHTS, outputWeights.bytes());
+    const void* outputBiasData = section(OUTPUT_BIAS, outputBias.bytes());
+    if (!ftWeightData || !ftBiasData || !l2WeightData || !l2BiasData || !outputWeightData || !outputBiasData) {
+        return false;
+    }
+
+    ftWeights.map(ftWeightData);
+    ftBiases.map(ftBiasData);
+    l2Weights.map(l2WeightData);
+    l2Biases.map(l2BiasData);
+    outputWeights.map(outputWeightData);
+    outputBias.map(outputBiasData);
+    mapping = view.mapping;
+    return true;
+}
+
+bool QuantizedNetwork::saveWeights(const std::string& path) const {
+    return NetworkFile::write(path, architectureHash(), {
+        {FT_WEIGHTS, ftWeights.data(), ftWeights.bytes()},
+        {FT_BIASES, ftBiases.data(), ftBiases.bytes()},
+        {L2_WEIGHTS, l2Weights.data(), l2Weights.bytes()},
+        {L2_BIASES, l2Biases.data(), l2Biases.bytes()},
+        {OUTPUT_WEIGHTS, outputWeights.data(), outputWeights.bytes()},
+        {OUTPUT_BIAS, outputBias.data(), outputBias.bytes()}
+    });
+}
+
+bool QuantizedNetwork::convertFloatWeights(const std::string& floatPath, const std::string& outPath,
+                                           std::string& error) {
+    auto source = NetworkWeights::load(floatPath);
+    if (!source) {
+        error = "cannot read " + floatPath + " or it has the wrong size";
+        return false;
+    }
+
+    QuantizedNetwork quantized;
+    quantized.quantize(*source);
+    if (!quantized.saveWeights(outPath)) {
+        error = "cannot write " + outPath;
+        return false;
+    }
+    return true;
+}
+
+void QuantizedNetwork::refreshAccumulator(const std::array<uint64_t, 12>& pieces, int perspective,
+                                          Accumulator& accumulator) const {
+    std::copy(ftBiases.data(), ftBiases.data() + FT_SIZE, accumulator.begin());
+
+    const int kingSquare = HalfKA::kingSquare(pieces, perspective);
+    for (int piece = 0; piece < 12; ++piece) {
+        uint64_t bb = pieces[piece];
+        while (bb) {
+            addFeature(accumulator, HalfKA::index(perspective, kingSquare, piece, std::countr_zero(bb)));
+            bb &= bb - 1;
+        }
+    }
+}
+
+void QuantizedNetwork::addFeature(Accumulator& accumulator, int feature) const {
+    Simd::kernels().addRow(accumulator.data(), &ftWeights[feature * FT_SIZE], FT_SIZE);
+}
+
+void QuantizedNetwork::removeFeature(Accumulator& accumulator, int feature) const {
+    Simd::kernels().subRow(accumulator.data(), &ftWeights[feature * FT_SIZE], FT_SIZE);
+}
+
+float QuantizedNetwork::forward(const Accumulator& us, const Accumulator& them) const {
+    alignas(64) std::array<uint8_t, L2_INPUT_SIZE> ftOutput;
+    alignas(64) std::array<uint8_t, L2_SIZE> l2Output;
+
+    const Simd::Kernels& simd = Simd::kernels();
+    simd.clippedReLU(ftOutput.data(), us.data(), FT_SIZE);
+    simd.clippedReLU(ftOutput.data() + FT_SIZE, them.data(), FT_SIZE);
+
+    // Most clipped activations are zero, so only the weights of non-zero
+    // input groups are touched.
+    alignas(64) std::array<uint16_t, L2_INPUT_SIZE / 4> nonZero;
+    alignas(64) std::array<int32_t, L2_SIZE> l2Sums;
+    const int count = simd.nonZeroBlocks(nonZero.data(), ftOutput.data(), L2_INPUT_SIZE);
+    std::copy(l2Biases.data(), l2Biases.data() + L2_SIZE, l2Sums.begin());
+    simd.sparseAffine(l2Sums.data(), ftOutput.data(), l2Weights.data(), nonZero.data(), count, L2_SIZE);
+
+    for (int out = 0; out < L2_SIZE; ++out) {
+        l2Output[out] = static_cast<uint8_t>(std::clamp(l2Sums[out] >> WEIGHT_SHIFT, 0, FT_SCALE));
+    }
+
+    int32_t sum = outputBias[0] + simd.dotProduct(l2Output.data(), outputWeights.data(), L2_SIZE);
+    return std::tanh(static_cast<float>(sum) / (FT_SCALE * WEIGHT_SCALE));
+}
+
+float QuantizedNetwork::evaluate(const std::array<uint64_t, 12>& pieces, int sideToMove) const {
+    std::array<Accumulator, 2> accumulators;
+    refreshAccumulator(pieces, HalfKA::WHITE, accumulators[HalfKA::WHITE]);
+    refreshAccumulator(pieces, HalfKA::BLACK, accumulators[HalfKA::BLACK]);
+    return forward(accumulators[sideToMove], accumulators[!sideToMove]);
+}
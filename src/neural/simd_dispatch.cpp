@@ -0,0 +1,97 @@
+#include "../../include/neural/simd_kernels.hpp"
+
+#if defined(CHESS_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+#if defined(CHESS_SIMD_X86)
+    struct CpuidRegisters {
+        uint32_t eax{0}, ebx{0}, ecx{0}, edx{0};
+    };
+
+    CpuidRegisters cpuid(uint32_t leaf, uint32_t subleaf) {
+        CpuidRegisters regs;
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        regs = {static_cast<uint32_t>(info[0]), static_cast<uint32_t>(info[1]),
+                static_cast<uint32_t>(info[2]), static_cast<uint32_t>(info[3])};
+#else
+        __cpuid_count(leaf, subleaf, regs.eax, regs.ebx, regs.ecx, regs.edx);
+#endif
+        return regs;
+    }
+
+    // Register state the OS saves on context switch (XCR0).
+    uint64_t enabledStateMask() {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+    constexpr bool hasBit(uint32_t reg, int bit) {
+        return (reg >> bit) & 1;
+    }
+#endif
+}
+
+Simd::Level Simd::detect() {
+#if defined(CHESS_SIMD_X86)
+    constexpr uint64_t YMM_STATE = 0x6;
+    constexpr uint64_t ZMM_STATE = 0xE6;
+
+    const uint32_t maxLeaf = cpuid(0, 0).eax;
+    const CpuidRegisters leaf1 = cpuid(1, 0);
+    const CpuidRegisters leaf7 = maxLeaf >= 7 ? cpuid(7, 0) : CpuidRegisters{};
+
+    if (!hasBit(leaf1.ecx, 19)) return Level::SCALAR;
+
+    const bool osxsave = hasBit(leaf1.ecx, 27);
+    const uint64_t xcr0 = osxsave ? enabledStateMask() : 0;
+
+    const bool avx2 = (xcr0 & YMM_STATE) == YMM_STATE &&
+                      hasBit(leaf1.ecx, 28) && hasBit(leaf1.ecx, 12) && hasBit(leaf7.ebx, 5);
+    if (!avx2) return Level::SSE41;
+
+    const bool avx512 = (xcr0 & ZMM_STATE) == ZMM_STATE &&
+                        hasBit(leaf7.ebx, 16) && hasBit(leaf7.ebx, 30);
+    if (!avx512) return Level::AVX2;
+
+    return hasBit(leaf7.ecx, 11) ? Level::AVX512_VNNI : Level::AVX512;
+#else
+    return Level::SCALAR;
+#endif
+}
+
+bool Simd::hasCrc32() {
+#if defined(CHESS_SIMD_X86)
+    static const bool available = hasBit(cpuid(1, 0).ecx, 20);
+    return available;
+#else
+    return false;
+#endif
+}
+
+const Simd::Kernels& Simd::kernels() {
+    static const Kernels& selected = []() -> const Kernels& {
+        switch (detect()) {
+#if defined(CHESS_SIMD_X86)
+            case Level::AVX512_VNNI: return AVX512_VNNI_KERNELS;
+            case Level::AVX512: return AVX512_KERNELS;
+            case Level::AVX2: return AVX2_KERNELS;
+            case Level::SSE41: return SSE41_KERNELS;
+#endif
+            default: return SCALAR_KERNELS;
+        }
+    }();
+    return selected;
+}
@@ -57,7 +57,7 @@ int ChessEngine::alphaBeta(int alpha, int beta, int depth, bool isPV) {
             continue;
         }
 
-        makeMove(move);
+        if (!makeMove(move)) continue;
         
         int score;
         if (i == 0) {
@@ -99,7 +99,7 @@ int ChessEngine::alphaBeta(int alpha, int beta, int depth, bool isPV) {
 }
 
 int ChessEngine::quiescence(int alpha, int beta) {
-    int standPat = evaluator->evaluate(pos.pieces, pos.occupied, pos.side, getGamePhase());
+    int standPat = evaluator->evaluate(board, alpha, beta);
     
     if (standPat >= beta) {
         return beta;
@@ -117,7 +117,7 @@ int ChessEngine::quiescence(int alpha, int beta) {
             continue;
         }
 
-        makeMove(move);
+        if (!makeMove(move)) continue;
         int score = -quiescence(-beta, -alpha);
         unmakeMove(move);
 
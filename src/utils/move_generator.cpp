@@ -1,183 +1,39 @@
 #include "../../include/utils/move_generator.hpp"
-#include <algorithm>
-#include <cassert>
+#include "../../include/board/attack_info.hpp"
+#include <bit>
 
-MoveGenerator::MoveGenerator() {
-    initializeLookupTables();
-}
-
-void MoveGenerator::initializeLookupTables() {
-    // Initialize pawn attacks
-    for (int square = 0; square < 64; square++) {
-        pawnAttacks[0][square] = generatePawnMoves(square, 0); 
-        pawnAttacks[1][square] = generatePawnMoves(square, 1); 
-    }
-
-    // Initialize knight moves
-    for (int square = 0; square < 64; square++) {
-        knightMoves[square] = generateKnightMoves(square);
-    }
-
-    // Initialize king moves
-    for (int square = 0; square < 64; square++) {
-        kingMoves[square] = generateKingMoves(square);
-    }
-}
-
-uint64_t MoveGenerator::generatePawnMoves(int square, int side) {
-    uint64_t moves = 0;
-    uint64_t bb = 1ULL << square;
-    
-    if (side == 0) { // White pawns
-        moves |= (bb << 8) & ~FILE_H; // Single push
-        if (square < 16) {
-            moves |= (bb << 16) & ~FILE_H; // Double push from starting position
+namespace {
+    void addMoves(std::vector<MoveGenerator::Move>& moves, int from, uint64_t targets) {
+        while (targets) {
+            moves.emplace_back(from, __builtin_ctzll(targets), 0, 0);
+            targets &= targets - 1;
         }
-        moves |= ((bb << 7) & ~FILE_A) | ((bb << 9) & ~FILE_H); // Captures
-    } else { // Black pawns
-        moves |= (bb >> 8) & ~FILE_A; // Single push
-        if (square >= 48) {
-            moves |= (bb >> 16) & ~FILE_A; // Double push from starting position
-        }
-        moves |= ((bb >> 7) & ~FILE_H) | ((bb >> 9) & ~FILE_A); // Captures
     }
-    
-    return moves;
 }
 
-uint64_t MoveGenerator::generateKnightMoves(int square) {
-    uint64_t moves = 0;
-    uint64_t bb = 1ULL << square;
-    
-    moves |= (bb << 17) & ~FILE_A;
-    moves |= (bb << 15) & ~FILE_H;
-    moves |= (bb << 10) & ~(FILE_A | FILE_B);
-    moves |= (bb << 6) & ~(FILE_G | FILE_H);
-    moves |= (bb >> 6) & ~(FILE_A | FILE_B);
-    moves |= (bb >> 10) & ~(FILE_G | FILE_H);
-    moves |= (bb >> 15) & ~FILE_A;
-    moves |= (bb >> 17) & ~FILE_H;
-    
-    return moves;
-}
+std::vector<MoveGenerator::Move> MoveGenerator::generateLegalMoves(
+    const std::array<uint64_t, 12>& pieces,
+    uint64_t occupied,
+    int sideToMove,
+    int castlingRights,
+    int enPassantSquare) const {
 
-uint64_t MoveGenerator::generateKingMoves(int square) {
-    uint64_t moves = 0;
-    uint64_t bb = 1ULL << square;
-    
-    moves |= (bb << 8) & ~FILE_H;
-    moves |= (bb << 9) & ~FILE_A;
-    moves |= (bb << 7) & ~FILE_H;
-    moves |= (bb << 1) & ~FILE_A;
-    moves |= (bb >> 1) & ~FILE_H;
-    moves |= (bb >> 7) & ~FILE_A;
-    moves |= (bb >> 8) & ~FILE_A;
-    moves |= (bb >> 9) & ~FILE_H;
-    
-    return moves;
-}
-
-uint64_t MoveGenerator::generateSlidingMoves(int square, const std::array<int, 8>& directions) {
-    uint64_t moves = 0;
-    uint64_t bb = 1ULL << square;
-    
-    for (int dir : directions) {
-        uint64_t ray = 0;
-        uint64_t current = bb;
-        
-        while (current && !(current & ((dir > 0) ? FILE_H : FILE_A))) {
-            current = (dir > 0) ? (current << dir) : (current >> -dir);
-            ray |= current;
-        }
-        
-        moves |= ray;
-    }
-    
-    return moves;
+    AttackInfo attacks;
+    attacks.compute(pieces, occupied, sideToMove);
+    return generateLegalMoves(pieces, occupied, sideToMove, castlingRights, enPassantSquare, attacks);
 }
 
 std::vector<MoveGenerator::Move> MoveGenerator::generateLegalMoves(
-    const std::array<uint64_t, 12>& pieces, 
+    const std::array<uint64_t, 12>& pieces,
     uint64_t occupied,
     int sideToMove,
     int castlingRights,
-    int enPassantSquare) {
-    
+    int enPassantSquare,
+    const AttackInfo& attacks) const {
+
     std::vector<Move> moves;
-    
-    // Generate pawn moves
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6] & (1ULL << sq)) {
-            uint64_t pawnMoves = generatePawnMoves(sq, sideToMove);
-            while (pawnMoves) {
-                int to = __builtin_ctzll(pawnMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                pawnMoves &= pawnMoves - 1;
-            }
-        }
-    }
-    
-    // Generate knight moves
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 1] & (1ULL << sq)) {
-            uint64_t knightMoves = generateKnightMoves(sq);
-            while (knightMoves) {
-                int to = __builtin_ctzll(knightMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                knightMoves &= knightMoves - 1;
-            }
-        }
-    }
-    
-    // Generate bishop moves
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 2] & (1ULL << sq)) {
-            uint64_t bishopMoves = generateSlidingMoves(sq, bishopDirections);
-            while (bishopMoves) {
-                int to = __builtin_ctzll(bishopMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                bishopMoves &= bishopMoves - 1;
-            }
-        }
-    }
-    
-    // Generate rook moves
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 3] & (1ULL << sq)) {
-            uint64_t rookMoves = generateSlidingMoves(sq, rookDirections);
-            while (rookMoves) {
-                int to = __builtin_ctzll(rookMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                rookMoves &= rookMoves - 1;
-            }
-        }
-    }
-    
-    // Generate queen moves
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 4] & (1ULL << sq)) {
-            uint64_t queenMoves = generateSlidingMoves(sq, bishopDirections) | 
-                                generateSlidingMoves(sq, rookDirections);
-            while (queenMoves) {
-                int to = __builtin_ctzll(queenMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                queenMoves &= queenMoves - 1;
-            }
-        }
-    }
-    
-    // Generate king moves
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 5] & (1ULL << sq)) {
-            uint64_t kingMoves = generateKingMoves(sq);
-            while (kingMoves) {
-                int to = __builtin_ctzll(kingMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                kingMoves &= kingMoves - 1;
-            }
-        }
-    }
-    
+    moves.reserve(64);
+    generate(pieces, occupied, sideToMove, castlingRights, enPassantSquare, attacks, false, moves);
     return moves;
 }
 
@@ -185,108 +41,167 @@ std::vector<MoveGenerator::Move> MoveGenerator::generateCaptures(
     const std::array<uint64_t, 12>& pieces,
     uint64_t occupied,
     int sideToMove,
-    int enPassantSquare) {
-    
+    int enPassantSquare) const {
+
+    AttackInfo attacks;
+    attacks.compute(pieces, occupied, sideToMove);
+    return generateCaptures(pieces, occupied, sideToMove, enPassantSquare, attacks);
+}
+
+std::vector<MoveGenerator::Move> MoveGenerator::generateCaptures(
+    const std::array<uint64_t, 12>& pieces,
+    uint64_t occupied,
+    int sideToMove,
+    int enPassantSquare,
+    const AttackInfo& attacks) const {
+
     std::vector<Move> moves;
-    uint64_t enemyPieces = 0;
-    for (int i = 0; i < 6; ++i) {
-        enemyPieces |= pieces[(!sideToMove) * 6 + i];
+    generate(pieces, occupied, sideToMove, 0, enPassantSquare, attacks, true, moves);
+    return moves;
+}
+
+void MoveGenerator::generate(const std::array<uint64_t, 12>& pieces, uint64_t occupied, int sideToMove,
+                             int castlingRights, int enPassantSquare, const AttackInfo& attacks,
+                             bool capturesOnly, std::vector<Move>& moves) const {
+    const int side = sideToMove;
+    const int them = !side;
+    const uint64_t kingBB = pieces[side * 6 + Board::KING];
+    if (!kingBB) return;
+
+    uint64_t own = 0;
+    uint64_t enemies = 0;
+    for (int piece = 0; piece < 6; ++piece) {
+        own |= pieces[side * 6 + piece];
+        enemies |= pieces[them * 6 + piece];
     }
-    
-    // Generate pawn captures
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6] & (1ULL << sq)) {
-            uint64_t pawnMoves = generatePawnMoves(sq, sideToMove) & enemyPieces;
-            while (pawnMoves) {
-                int to = __builtin_ctzll(pawnMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                pawnMoves &= pawnMoves - 1;
-            }
+    const int kingSquare = attacks.kingSquare[side];
+
+    // The king is lifted off the board for its own steps, so it cannot
+    // shelter from a slider behind itself.
+    uint64_t kingTargets = Attacks::king(kingSquare) & ~own & ~attacks.bySide[them];
+    if (capturesOnly) kingTargets &= enemies;
+    while (kingTargets) {
+        const int to = __builtin_ctzll(kingTargets);
+        if (!(AttackInfo::attackersTo(pieces, to, occupied ^ kingBB) & enemies)) {
+            moves.emplace_back(kingSquare, to, 0, 0);
         }
+        kingTargets &= kingTargets - 1;
     }
-    
-    // Generate knight captures
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 1] & (1ULL << sq)) {
-            uint64_t knightMoves = generateKnightMoves(sq) & enemyPieces;
-            while (knightMoves) {
-                int to = __builtin_ctzll(knightMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                knightMoves &= knightMoves - 1;
-            }
+
+    if (std::popcount(attacks.checkers) > 1) return;
+
+    // In check, other pieces must capture the checker or block it.
+    uint64_t targetMask = ~own;
+    if (attacks.checkers) {
+        targetMask &= attacks.checkers | AttackInfo::between(kingSquare, __builtin_ctzll(attacks.checkers));
+    }
+
+    // Pinned pieces may only move along the line between king and pinner.
+    std::array<uint64_t, 64> pinRays;
+    uint64_t pinned = 0;
+    uint64_t snipers =
+        (Attacks::bishop(kingSquare, 0) & (pieces[them * 6 + Board::BISHOP] | pieces[them * 6 + Board::QUEEN])) |
+        (Attacks::rook(kingSquare, 0) & (pieces[them * 6 + Board::ROOK] | pieces[them * 6 + Board::QUEEN]));
+    while (snipers) {
+        const int sniper = __builtin_ctzll(snipers);
+        const uint64_t ray = AttackInfo::between(kingSquare, sniper);
+        const uint64_t blockers = ray & occupied;
+        if (std::popcount(blockers) == 1 && (blockers & own)) {
+            pinned |= blockers;
+            pinRays[__builtin_ctzll(blockers)] = ray | (1ULL << sniper);
         }
+        snipers &= snipers - 1;
     }
-    
-    // Generate bishop captures
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 2] & (1ULL << sq)) {
-            uint64_t bishopMoves = generateSlidingMoves(sq, bishopDirections) & enemyPieces;
-            while (bishopMoves) {
-                int to = __builtin_ctzll(bishopMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                bishopMoves &= bishopMoves - 1;
+    auto allowed = [&](int from) { return (pinned >> from) & 1 ? pinRays[from] : ~0ULL; };
+
+    for (int type = Board::KNIGHT; type <= Board::QUEEN; ++type) {
+        uint64_t bb = pieces[side * 6 + type];
+        while (bb) {
+            const int from = __builtin_ctzll(bb);
+            uint64_t targets = 0;
+
+            switch (type) {
+                case Board::KNIGHT: targets = Attacks::knight(from); break;
+                case Board::BISHOP: targets = Attacks::bishop(from, occupied); break;
+                case Board::ROOK: targets = Attacks::rook(from, occupied); break;
+                case Board::QUEEN: targets = Attacks::queen(from, occupied); break;
             }
+
+            targets &= targetMask & allowed(from);
+            if (capturesOnly) targets &= enemies;
+            addMoves(moves, from, targets);
+            bb &= bb - 1;
         }
     }
-    
-    // Generate rook captures
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 3] & (1ULL << sq)) {
-            uint64_t rookMoves = generateSlidingMoves(sq, rookDirections) & enemyPieces;
-            while (rookMoves) {
-                int to = __builtin_ctzll(rookMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                rookMoves &= rookMoves - 1;
+
+    const int forward = side == Board::WHITE ? 8 : -8;
+    const uint64_t startRank = side == Board::WHITE ? RANK_2 : RANK_7;
+    const uint64_t promotionRank = side == Board::WHITE ? RANK_8 : RANK_1;
+    uint64_t pawns = pieces[side * 6 + Board::PAWN];
+    while (pawns) {
+        const int from = __builtin_ctzll(pawns);
+        const uint64_t fromBB = 1ULL << from;
+        uint64_t targets = Attacks::pawn(side, from) & enemies;
+
+        const int single = from + forward;
+        if (!((occupied >> single) & 1)) {
+            targets |= 1ULL << single;
+            if ((fromBB & startRank) && !((occupied >> (single + forward)) & 1)) {
+                targets |= 1ULL << (single + forward);
             }
         }
-    }
-    
-    // Generate queen captures
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 4] & (1ULL << sq)) {
-            uint64_t queenMoves = (generateSlidingMoves(sq, bishopDirections) | 
-                                 generateSlidingMoves(sq, rookDirections)) & enemyPieces;
-            while (queenMoves) {
-                int to = __builtin_ctzll(queenMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                queenMoves &= queenMoves - 1;
+
+        targets &= targetMask & allowed(from);
+        if (capturesOnly) targets &= enemies | promotionRank;
+        while (targets) {
+            const int to = __builtin_ctzll(targets);
+            if ((1ULL << to) & promotionRank) {
+                for (int promotion = Board::KNIGHT; promotion <= Board::QUEEN; ++promotion) {
+                    moves.emplace_back(from, to, promotion, 0);
+                }
+            } else {
+                moves.emplace_back(from, to, 0, 0);
             }
+            targets &= targets - 1;
         }
-    }
-    
-    // Generate king captures
-    for (int sq = 0; sq < 64; ++sq) {
-        if (pieces[sideToMove * 6 + 5] & (1ULL << sq)) {
-            uint64_t kingMoves = generateKingMoves(sq) & enemyPieces;
-            while (kingMoves) {
-                int to = __builtin_ctzll(kingMoves);
-                moves.push_back(Move(sq, to, 0, 0));
-                kingMoves &= kingMoves - 1;
+
+        // En passant removes two pieces from one line at once, so it is
+        // checked by replaying it rather than with the masks above.
+        if (enPassantSquare != -1 && ((Attacks::pawn(side, from) >> enPassantSquare) & 1)) {
+            const uint64_t capturedBB = 1ULL << (enPassantSquare - forward);
+            const uint64_t toBB = 1ULL << enPassantSquare;
+            auto after = pieces;
+            after[side * 6 + Board::PAWN] ^= fromBB | toBB;
+            after[them * 6 + Board::PAWN] ^= capturedBB;
+            const uint64_t afterOccupied = (occupied ^ fromBB ^ capturedBB) | toBB;
+            if (!(AttackInfo::attackersTo(after, kingSquare, afterOccupied) & (enemies ^ capturedBB))) {
+                moves.emplace_back(from, enPassantSquare, 0, 0);
             }
         }
-    }
-    
-    return moves;
-}
 
-bool MoveGenerator::isAttacked(uint64_t square, int side, uint64_t occupied) {
-    // Check pawn attacks
-    if (pawnAttacks[!side][__builtin_ctzll(square)] & pieces[side * 6]) {
-        return true;
+        pawns &= pawns - 1;
     }
-    
-    // Check knight attacks
-    if (knightMoves[__builtin_ctzll(square)] & pieces[side * 6 + 1]) {
-        return true;
-    }
-    
-    // Check king attacks
-    if (kingMoves[__builtin_ctzll(square)] & pieces[side * 6 + 5]) {
-        return true;
+
+    if (capturesOnly || attacks.checkers) return;
+
+    // Castling: rights, an empty path and no attacked square the king crosses.
+    if (side == Board::WHITE) {
+        if ((castlingRights & 1) && !(occupied & 0x60ULL) &&
+            !attacks.isAttacked(5, them) && !attacks.isAttacked(6, them)) {
+            moves.emplace_back(4, 6, 0, 0);
+        }
+        if ((castlingRights & 2) && !(occupied & 0xEULL) &&
+            !attacks.isAttacked(3, them) && !attacks.isAttacked(2, them)) {
+            moves.emplace_back(4, 2, 0, 0);
+        }
+    } else {
+        if ((castlingRights & 4) && !(occupied & 0x6000000000000000ULL) &&
+            !attacks.isAttacked(61, them) && !attacks.isAttacked(62, them)) {
+            moves.emplace_back(60, 62, 0, 0);
+        }
+        if ((castlingRights & 8) && !(occupied & 0x0E00000000000000ULL) &&
+            !attacks.isAttacked(59, them) && !attacks.isAttacked(58, them)) {
+            moves.emplace_back(60, 58, 0, 0);
+        }
     }
-    
-    // Check sliding piece attacks (bishops, rooks, queens)
-    // This would need to be implemented with proper sliding piece attack generation
-    
-    return false;
 }